@@ -0,0 +1,94 @@
+#ifndef LOGICOL_H
+#define LOGICOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The embedding API of Logicol, for driving simulations from other languages.
+// The library is the core package, which needs no raylib:
+//   cc -O2 -fPIC -shared -fvisibility=hidden -Icore/include core/src/*.c -lm -lpthread -o liblogicol.so
+// Handles are opaque and a call moves whole arrays of INPUT and OUTPUT
+// values, so running many cycles costs one call rather than one per pin.
+// Only additions are made within an API version.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LOGICOL_API_VERSION 1
+
+#ifndef LOGICOL_EXPORT
+#define LOGICOL_EXPORT __attribute__((visibility("default")))
+#endif
+
+typedef struct LogicolProject LogicolProject;
+typedef struct LogicolSimulation LogicolSimulation;
+
+// Flags of logicol_compile
+#define LOGICOL_FOUR_STATE 1  // Simulates X and Z, implied by tri-state buses
+#define LOGICOL_LOWER_WORDS 2 // Builds word ops out of NANDs
+#define LOGICOL_CACHE 4       // Reuses and fills the netlist cache in .logicol
+
+// The LOGICOL_API_VERSION the library was built with
+LOGICOL_EXPORT uint32_t logicol_version(void);
+
+// NULL when the file cannot be read
+LOGICOL_EXPORT LogicolProject* logicol_load(const char* path);
+
+// Only once its simulations have been freed, they share its ROM images
+LOGICOL_EXPORT void logicol_free_project(LogicolProject* project);
+
+LOGICOL_EXPORT size_t logicol_num_circuits(const LogicolProject* project);
+
+// Valid until the project is freed
+LOGICOL_EXPORT const char* logicol_circuit_name(const LogicolProject* project, size_t index);
+
+// Compiles the circuit called `name`, or the first one when NULL. NULL when
+// there is no such circuit.
+LOGICOL_EXPORT LogicolSimulation* logicol_compile(LogicolProject* project, const char* name, uint32_t flags);
+
+LOGICOL_EXPORT void logicol_free_simulation(LogicolSimulation* simulation);
+
+// INPUTs and OUTPUTs are numbered in the order they were placed, each is up
+// to 64 bits wide and passed as one uint64_t
+LOGICOL_EXPORT size_t logicol_num_inputs(const LogicolSimulation* simulation);
+LOGICOL_EXPORT size_t logicol_num_outputs(const LogicolSimulation* simulation);
+LOGICOL_EXPORT size_t logicol_input_width(const LogicolSimulation* simulation, size_t index);
+LOGICOL_EXPORT size_t logicol_output_width(const LogicolSimulation* simulation, size_t index);
+
+// Sets every INPUT, the values take effect in the next cycle
+LOGICOL_EXPORT void logicol_set_inputs(LogicolSimulation* simulation, const uint64_t* values);
+
+// The OUTPUTs after the last cycle. `unknown` gets the bits that are X or Z
+// and may be NULL.
+LOGICOL_EXPORT void logicol_get_outputs(const LogicolSimulation* simulation, uint64_t* values, uint64_t* unknown);
+
+// Runs `cycles` cycles. `inputs` holds logicol_num_inputs values per cycle,
+// or is NULL to keep the INPUTs as they are. `outputs` and `unknown` receive
+// logicol_num_outputs values per cycle, as logicol_get_outputs, and may be
+// NULL. Returns the number of cycles run since the circuit was compiled.
+LOGICOL_EXPORT uint64_t logicol_run(LogicolSimulation* simulation, const uint64_t* inputs, uint64_t* outputs,
+                                    uint64_t* unknown, size_t cycles);
+
+// Stimulus modes of logicol_generate. Counters and walking bits span the
+// bits of all INPUTs, the first one lowest.
+#define LOGICOL_UNIFORM 1       // Every bit random
+#define LOGICOL_BIASED 2        // Bits of INPUT i are 1 with probability biases[i]
+#define LOGICOL_WALKING_ONES 3  // A single 1 moving up a bit every cycle
+#define LOGICOL_WALKING_ZEROS 4 // A single 0 moving up a bit every cycle
+#define LOGICOL_COUNT 5         // The cycle number
+
+// Fills `inputs` with the INPUT values of `cycles` cycles from cycle `first`
+// on, for logicol_run. The values of a cycle only depend on the mode, seed,
+// biases and the cycle, so a failing one can be generated again alone.
+// `biases` has one probability per INPUT, resolved to 1/256, or is NULL
+// for 0.5. Returns 0, or -1 for an unknown mode, which leaves `inputs` all
+// 0.
+LOGICOL_EXPORT int logicol_generate(const LogicolSimulation* simulation, uint32_t mode, uint64_t seed,
+                                    const double* biases, uint64_t first, uint64_t* inputs, size_t cycles);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
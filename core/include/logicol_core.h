@@ -0,0 +1,798 @@
+#ifndef LOGICOL_CORE_H
+#define LOGICOL_CORE_H
+
+// The data model, loader, compiler and simulators of Logicol, shared by the
+// editor, logicol-sim and the embedding library. Only the types and functions
+// used across source files are declared here.
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "logicol.h"
+
+// raylib's, for builds that do not include raylib.h before this
+#ifndef RL_VECTOR2_TYPE
+typedef struct Vector2 {
+  float x;
+  float y;
+} Vector2;
+#define RL_VECTOR2_TYPE
+#endif
+
+// model.c
+
+typedef int8_t   i8;
+typedef int16_t  i16;
+typedef int32_t  i32;
+typedef int64_t  i64;
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64; 
+typedef float    f32;
+typedef double   f64;
+typedef size_t   usize;
+
+typedef struct {
+  usize length;
+  char* data;
+} String;
+
+typedef struct Component Component;
+typedef usize ComponentRef;
+typedef usize CircuitRef;
+
+#define NO_PATH ((usize)-1)
+
+typedef struct {
+	usize outputIndex;
+	ComponentRef component;
+} Input;
+
+typedef enum Logic {
+  LOGIC_0 = 0,
+  LOGIC_1,
+  LOGIC_X,
+  LOGIC_Z,
+} Logic;
+
+// What a component is, interned from its name when it is created or loaded
+// so kind checks are integer compares. A name that is no primitive is an
+// instance of the circuit of that name.
+typedef enum Kind {
+  KIND_CIRCUIT = 0,
+  KIND_INPUT,
+  KIND_OUTPUT,
+  KIND_CLOCK,
+  KIND_SPLIT,
+  KIND_MERGE,
+  KIND_NOT,
+  KIND_AND,
+  KIND_OR,
+  KIND_TRISTATE,
+  KIND_BUS,
+  KIND_ADD,
+  KIND_SUB,
+  KIND_CMP,
+  KIND_MUX,
+  KIND_SHL,
+  KIND_SHR,
+  KIND_MUL,
+  KIND_ROM,
+  KIND_RAM,
+  KIND_RAM2,
+  NUM_KINDS,
+} Kind;
+
+typedef struct Component {
+	ComponentRef id;
+	Vector2 pos;
+	String name;
+	Kind kind;
+	// Of an instance, resolved from the name by getDefinition
+	CircuitRef definition;
+	usize numInputs;
+	Input* inputs;
+	usize numOutputs;
+	u64* outputs;
+	usize width;
+	bool ticked;
+  Logic state;
+
+  // Contents of ROM, RAM and RAM2, (1 << addressWidth) words of whole bytes.
+  // A ROM maps its image file read-only, RAMs own a heap array.
+  usize addressWidth;
+  u8* memory;
+  usize memorySize;
+  String image;
+
+  // Of everything the component compiles to, see hashComponent
+  u64 hash;
+
+  // Timing, in NAND levels from the nearest source, kept up to date by updateTiming
+  usize* arrival;
+  usize* arrivalPin;
+  usize criticalPin;
+  usize numFanouts;
+  ComponentRef* fanouts;
+  usize timingEpoch;
+  usize timingVisits;
+  bool timingQueued;
+
+  // Layout in the editor, see layoutComponent. The name and id are formatted
+  // and measured once, the pins are placed again when the position or pin
+  // counts change.
+  bool measured;
+  char* nameText;
+  char idText[24];
+  Vector2 nameSize;
+  Vector2 idSize;
+  Vector2 size;
+  Vector2 layoutPos;
+  usize layoutInputs;
+  usize layoutOutputs;
+  Vector2* pins;
+
+  // Cells of the circuit's grid it is filed in, see gridComponent
+  bool filed;
+  i32 cellLeft;
+  i32 cellTop;
+  i32 cellRight;
+  i32 cellBottom;
+} Component;
+
+// A component placed as an instance of a circuit
+typedef struct {
+  CircuitRef circuit;
+  ComponentRef component;
+} InstanceRef;
+
+// Uniform grid over the components of a circuit for hit testing in the
+// editor. Each cell lists the components a click inside it can hit. Cells
+// are found by open addressing on their coordinates, kept at most half full,
+// and never removed, an unused slot has no capacity.
+typedef struct {
+  i32 x;
+  i32 y;
+  usize numComponents;
+  usize capacity;
+  ComponentRef* components;
+} GridCell;
+
+typedef struct {
+  usize capacity;
+  usize numCells;
+  GridCell* cells;
+  // Components are only added, the ones from here on are filed by queryGrid
+  usize numFiled;
+} Grid;
+
+typedef struct {
+  CircuitRef id;
+	usize numComponents;
+	Component* components;
+  String name;
+
+  // Everywhere this circuit is used, kept up to date by resolveInstance.
+  // Components are never removed, so neither are instances.
+  usize numInstances;
+  InstanceRef* instances;
+
+  Grid grid;
+
+  // XOR of the hashes of its components, kept up to date by every edit so an
+  // edit and its undo hash the same. getCircuitHash adds the definitions.
+  u64 contentHash;
+
+  // That combined with the hashes of its definitions, dropped by invalidateHash
+  // up through the instances whenever contentHash changes
+  u64 hash;
+  bool hashValid;
+  bool hashBusy;
+
+  // Live timing of the circuit while it is being edited
+  bool timingValid;
+  bool timingLoop;
+  usize depth;
+  usize numCriticalPath;
+  ComponentRef* criticalPath;
+
+  // Pin-to-pin delays of an instance of this circuit, (inputs + 1) x outputs
+  bool delaysValid;
+  bool delaysBusy;
+  usize delaysStamp;
+  usize delaysEpoch;
+  usize delayInputs;
+  usize delayOutputs;
+  usize* delays;
+} Circuit;
+
+// Open addressing index of the circuits by name, kept at most half full.
+// Slots hold CircuitRefs, 0 marks an empty one.
+typedef struct {
+  usize capacity;
+  CircuitRef* slots;
+} CircuitIndex;
+
+typedef struct {
+  usize numCircuits;
+  Circuit* circuits;
+  CircuitIndex names;
+} Project;
+
+#define MAX_WIDTH 64
+#define MAX_ADDRESS_WIDTH 24
+
+#define HASH(thing) hash = hashBytes(hash, &thing, sizeof(thing))
+
+typedef struct {
+  bool allInputs;
+  ComponentRef input;
+  bool internal;
+} TimingSources;
+
+extern const char* KIND_NAMES[NUM_KINDS];
+
+String createString();
+void destroyString(String* string);
+String fromCString(const char* data);
+void appendString(String* base, String* extra);
+char* toCString(String* string);
+bool stringEqualCString(String* a, const char* b);
+String cloneString(String* base);
+Kind getKind(String* name);
+Project createProject();
+Circuit* getCircuit(Project* project, CircuitRef ref);
+u64 hashBytes(u64 hash, const void* data, usize size);
+void indexCircuits(Project* project);
+CircuitRef addCircuit(Project* project, String name);
+Circuit* findCircuit(Project* project, String* name);
+Component* getComponent(Circuit* circuit, ComponentRef ref);
+Circuit* resolveInstance(Project* project, Circuit* owner, Component* component);
+Circuit* findOwner(Project* project, Component* component);
+Circuit* getDefinition(Project* project, Component* component);
+u64 getWidthMask(usize width);
+Component* getPort(Circuit* definition, Kind kind, usize index);
+bool isWordOp(Component* component);
+bool isMemory(Component* component);
+usize getWordBytes(usize width);
+void releaseMemory(Component* component);
+void updateMemory(Component* component);
+void mapImage(Component* component);
+usize getInputWidth(Project* project, Component* component, usize pin);
+usize getOutputWidth(Project* project, Component* component, usize pin);
+void invalidateHash(Project* project, Circuit* circuit);
+void rehashComponent(Project* project, Circuit* circuit, Component* component);
+void rehashCircuit(Project* project, Circuit* circuit);
+ComponentRef addComponent(Project* project, Circuit* circuit, String name, usize numInputs, usize numOutputs);
+usize getPinArrival(Circuit* circuit, Component* component, usize pin, TimingSources sources);
+void refreshTiming(Project* project, Circuit* circuit);
+void updateTiming(Project* project, Circuit* circuit, ComponentRef changed);
+void addFanout(Component* component, ComponentRef to);
+void addConnection(Project* project, Circuit* circuit, ComponentRef from, ComponentRef to, usize fromIndex, usize toIndex);
+void setWidth(Project* project, Circuit* circuit, Component* component, usize width);
+void setAddressWidth(Project* project, Circuit* circuit, Component* component, usize addressWidth);
+void updateInputs(Project* project, Circuit* active);
+void updateOutputs(Project* project, Circuit* active);
+
+// compile.c
+
+typedef enum NodeType {
+  NAND = 0, 
+  INPUT, 
+  FLOATING,
+  FLOAT_TO_X,
+  TRISTATE,
+  RESOLVE,
+  CONSTANT,
+  ALIAS,
+  WORD,
+  SLICE,
+  PORT,
+  CLOCK, // Set by the simulator before each tick
+} NodeType;
+
+typedef enum WordOp {
+  WORD_ADD = 0,
+  WORD_SUB,
+  WORD_CMP,
+  WORD_MUX,
+  WORD_SHL,
+  WORD_SHR,
+  WORD_MUL,
+  WORD_ROM,
+  WORD_RAM,
+  WORD_RAM2,
+  WORD_STORE,
+  WORD_CALL,
+} WordOp;
+
+typedef struct Netlist Netlist;
+typedef struct Memo Memo;
+
+// A BUS whose drivers disagree in `lanes`
+typedef struct {
+  CircuitRef circuit;
+  ComponentRef component;
+  u64 lanes;
+} Conflict;
+
+#define MAX_CONFLICTS 16
+
+// A word op of the netlist, reading and writing one net per bit
+typedef struct {
+  WordOp op;
+  usize width;
+  usize numOperands;
+  u32* operands;
+  usize numResults;
+  u32* results;
+
+  // Memories read and stores write `memory`. In the root circuit that is the
+  // component's own array, instances get a copy shared by their read and store.
+  usize addressWidth;
+  u8* memory;
+  usize memorySize;
+  bool ownsMemory;
+
+  // A CALL evaluates `module` on the state of its own `instance`, or on one
+  // lane of a shared state when it is part of `batch` (1-based)
+  Netlist* module;
+  Netlist* instance;
+  usize batch;
+
+  // Where the word came from, so a rebuilt netlist can take over the state of
+  // the one it replaces
+  CircuitRef circuit;
+  ComponentRef component;
+  usize path;
+} Word;
+
+// An output bit of a component in instance `path` below the root, 0 being
+// the root itself, and the net carrying it. Probes are what coverage counts.
+typedef struct {
+  u32 net;
+  u32 path;
+  u32 output;
+  u32 bit;
+  CircuitRef circuit;
+  ComponentRef component;
+} Probe;
+
+// Instance `path` is `component` of `circuit` placed in instance `parent`
+typedef struct {
+  usize parent;
+  CircuitRef circuit;
+  ComponentRef component;
+} InstancePath;
+
+// Calls of one module on one level, evaluated together with one instance per
+// lane of `state`
+typedef struct {
+  Netlist* module;
+  Netlist* state;
+  usize numCalls;
+  u32* calls;
+} Batch;
+
+// Four-state values are kept as two bit-planes per net, `one` holding the
+// lanes that may be 1 and `zero` the lanes that may be 0, so X is both and Z
+// neither. Two-state evaluation only looks at `one`.
+//
+// A Tree flattened into arrays ordered by level, every node only reading
+// nodes of lower levels. Each u64 carries 64 independent lanes, of which word
+// ops only compute the first `numLanes`.
+typedef struct Netlist {
+  usize numNodes;
+  u8* types;
+  u32* left;
+  u32* right;
+  u64* one;
+  u64* zero;
+  usize numLevels;
+  usize* levels;
+  usize numRoots;
+  u32* roots;
+  bool needsFourState;
+  usize numResolvers;
+  u32* resolvers;
+  ComponentRef* resolverComponents;
+  CircuitRef* resolverCircuits;
+  usize numWords;
+  Word* words;
+  usize numLanes;
+
+  // Nets of each INPUT bit, PORTs of a module are set through these
+  usize numPorts;
+  u32* ports;
+  usize numClocks;
+  u32* clocks;
+  bool hasStores;
+
+  // An instance only owns its state, the net values, words and memories, and
+  // shares everything else with its module. The root of a hierarchical
+  // simulation owns the modules.
+  bool shared;
+  Memo* modules;
+  usize numBatches;
+  Batch* batches;
+
+  // Every component output bit of the flattened design, and the instances
+  // they are in
+  usize numProbes;
+  Probe* probes;
+  usize numPaths;
+  InstancePath* paths;
+
+  // The circuit the netlist was compiled from, and for a module its Merkle
+  // hash at the time
+  CircuitRef definition;
+  u64 hash;
+
+  // A netlist loaded from the cache uses everything but the net values and
+  // words from the mapped file
+  u8* mapping;
+  usize mappingSize;
+} Netlist;
+
+typedef struct Node Node;
+typedef struct Node {
+  Node* left;
+  Node* right;
+  usize net;
+  bool output;
+  NodeType type;
+  Circuit* circuit;
+  Component* component;
+
+  // WORD nodes read `numOperands` bits and SLICE nodes take `bit` of the
+  // result of the WORD node on their left. Memory WORDs keep the instance
+  // `path` of their component, 0 in the root circuit, and CALL WORDs the
+  // compiled `module` of their definition.
+  WordOp op;
+  usize width;
+  usize numOperands;
+  Node** operands;
+  usize bit;
+  usize path;
+  Netlist* module;
+} Node;
+
+// Memory writes are roots of their own, they must happen even when nothing
+// reads the memory
+typedef struct {
+  usize numRoots;
+  Node* roots;
+  usize numMemories;
+  Node** memories;
+  Circuit* circuit;
+  Memo* modules;
+
+  // Probes get their net once the tree is flattened, from `probeNodes`
+  usize numProbes;
+  Probe* probes;
+  Node** probeNodes;
+  usize numPaths;
+  InstancePath* paths;
+} Tree;
+
+// Open addressing map from four words to a pointer, a zero second word marks
+// an empty slot
+typedef struct {
+  usize key[4];
+  void* value;
+} MemoEntry;
+
+typedef struct Memo {
+  usize count;
+  usize capacity;
+  MemoEntry* entries;
+} Memo;
+
+// Keeps the modules of hierarchical simulations between compiles, so an edit
+// only recompiles the definitions it touched and the ones instantiating them.
+// Modules dropped from the cache may still be called by a netlist being
+// simulated, they are `retired` until it has been replaced.
+typedef struct {
+  Memo modules;
+  bool lowerWords;
+  usize numRetired;
+  Netlist** retired;
+  usize numCompiled; // By the last compile
+} ModuleCache;
+
+void** findMemo(Memo* memo, usize a, usize b, usize c, usize d);
+void destroyMemo(Memo* memo);
+usize getValueWidth(WordOp op, usize width);
+usize getNumFlags(WordOp op);
+Tree compileProject(Project* project, Circuit* root, bool lowerWords, bool hierarchical);
+u64 getDesignHash(Project* project, Circuit* root, bool lowerWords);
+void destroyModules(Netlist** modules, usize numModules);
+void destroyModuleCache(ModuleCache* cache);
+Netlist compileIncremental(Project* project, Circuit* root, ModuleCache* cache, bool lowerWords);
+void transferMemories(Netlist* from, Netlist* to);
+
+// netlist.c
+
+Netlist flattenTree(Tree tree);
+void destroyNetlist(Netlist* netlist);
+void instantiateWords(Netlist* netlist);
+void copyMemories(Netlist* netlist);
+void batchInstances(Netlist* netlist);
+void tickNetlist(Netlist* netlist);
+void tickNetlist4(Netlist* netlist);
+usize findConflicts(Netlist* netlist, Conflict* conflicts, usize capacity, usize count);
+void applyConflicts(Project* project, Conflict* conflicts, usize count, bool print);
+Logic getLogic(Netlist* netlist, u32 net, usize lane, bool fourState);
+
+// trace.c
+
+typedef struct {
+  char name[32];
+  usize width;
+  usize first;
+} Signal;
+
+typedef struct {
+  usize numSignals;
+  Signal* signals;
+  usize numPorts;
+  usize numBits;
+  usize frameWords;
+  usize recordWords;
+  usize capacity;
+  u64* records;
+  _Atomic u64 written;
+  _Atomic u64 lastTick;
+  _Atomic u64 read;
+  bool blocking;
+
+  // Only touched by the simulation thread
+  u32* nets;
+  u64* frame;
+
+  FILE* file;
+  pthread_t writer;
+  _Atomic bool stopping;
+  _Atomic bool detached;
+} Trace;
+
+Logic getTracedBit(u64* frame, usize bit);
+bool bindTrace(Trace* trace, Netlist* netlist);
+void captureTrace(Trace* trace, Netlist* netlist, u64 tick, bool fourState);
+bool readRecord(Trace* trace, u64 index, u64* record);
+Trace* createTrace(Circuit* root, const char* path);
+void detachTrace(Trace* trace);
+void destroyTrace(Trace* trace);
+
+// coverage.c
+
+// Toggle coverage of the probes of a netlist. After every tick the nets they
+// are on are XORed with their previous values, the set bits are counted and
+// remembered as rising or falling, in every lane the netlist uses. Counts
+// are relaxed atomics, written by the simulation and read by the editor.
+// Everything a tick touches of a net shares a cache line.
+typedef struct {
+  u64 previous;
+  _Atomic u64 toggles;
+  _Atomic u64 rises;
+  _Atomic u64 falls;
+} CoverageNet;
+
+typedef struct {
+  CircuitRef root;
+  usize numProbes;
+  Probe* probes;
+  usize numPaths;
+  InstancePath* paths;
+
+  // Probes share a net when one component passes another's output on
+  usize numNets;
+  u32* nets;
+  u32* probeNets;
+  CoverageNet* states;
+  _Atomic u64 samples;
+  _Atomic bool detached;
+} Coverage;
+
+Coverage* createCoverage(Netlist* netlist);
+void destroyCoverage(Coverage* coverage);
+void sampleCoverage(Coverage* coverage, Netlist* netlist);
+bool isProbeCovered(Coverage* coverage, usize probe);
+u64 getProbeToggles(Coverage* coverage, usize probe);
+void printInstanceName(FILE* file, Project* project, Coverage* coverage, usize path);
+void reportCoverage(FILE* file, Project* project, Coverage* coverage);
+
+// power.c
+
+// Switching power from toggle coverage. A toggle of an output bit charges
+// the capacitance of the gate driving it and of every pin it fans out to,
+// C V^2 / 2 of energy. Capacitances are in fF and volts in V, so energies
+// come out in fJ. INPUTs, OUTPUTs, SPLITs, MERGEs and subcircuit instances
+// are wire and only carry their fanout.
+#define MAX_GATE_KINDS 32
+
+typedef struct {
+  usize numKinds;
+  char kinds[MAX_GATE_KINDS][32];
+  f64 capacitances[MAX_GATE_KINDS];
+  f64 fanout;
+  f64 voltage;
+} PowerModel;
+
+PowerModel createPowerModel();
+bool loadPowerModel(PowerModel* model, const char* path);
+f64* getProbeEnergies(Project* project, Coverage* coverage, PowerModel* model);
+void reportPower(FILE* file, Project* project, Coverage* coverage, PowerModel* model);
+
+// simulator.c
+
+// The simulation runs on a thread of its own. The editor sends it netlists and
+// input changes through a single-producer single-consumer ring, and reads back
+// the root values it publishes behind a sequence lock.
+typedef enum EventType {
+  EVENT_NETLIST,
+  EVENT_INPUT,
+  EVENT_RUN,
+  EVENT_STEP,
+  EVENT_TRACE,
+  EVENT_STOP,
+} EventType;
+
+typedef struct {
+  EventType type;
+
+  // EVENT_NETLIST hands over the netlist, the simulator destroys it along
+  // with the modules retired since the last one
+  Netlist* netlist;
+  bool fourState;
+  usize generation;
+  usize numRetired;
+  Netlist** retired;
+
+  // EVENT_INPUT sets `width` ports from `port` on
+  usize port;
+  usize width;
+  u64 value;
+
+  // EVENT_RUN ticks continuously at `rate` ticks per second, or as fast as it
+  // can at 0. EVENT_STEP ticks once while paused.
+  bool running;
+  double rate;
+
+  // EVENT_TRACE starts capturing every tick into `trace`, or stops at NULL
+  Trace* trace;
+
+  // EVENT_NETLIST also hands over the coverage of the netlist, or NULL. The
+  // simulator detaches the one it had.
+  Coverage* coverage;
+} Event;
+
+#define QUEUE_SIZE 256
+
+typedef struct {
+  _Atomic usize head;
+  _Atomic usize tail;
+  Event events[QUEUE_SIZE];
+} Queue;
+
+#define MAX_PUBLISHED 4096
+
+// What the editor sees of the simulation, the values of the roots in lane 0
+// after tick `ticks` of the netlist sent as `generation`
+typedef struct {
+  usize generation;
+  u64 ticks;
+  usize numRoots;
+  u8 roots[MAX_PUBLISHED];
+  usize numConflicts;
+  Conflict conflicts[MAX_CONFLICTS];
+} Snapshot;
+
+typedef struct {
+  pthread_t thread;
+  Queue events;
+
+  // Odd while the snapshot is being written
+  _Atomic usize sequence;
+  Snapshot published;
+
+  // Only touched by the simulation thread. Ticks that run or step the
+  // simulation advance the CLOCKs, a tick settling a change does not.
+  Netlist* netlist;
+  bool fourState;
+  usize generation;
+  bool dirty;
+  u64 ticks;
+  u64 cycles;
+  usize steps;
+  bool running;
+  double rate;
+  Trace* trace;
+  Coverage* coverage;
+} Simulator;
+
+double getSeconds();
+void sleepSeconds(double seconds);
+Snapshot readSnapshot(Simulator* simulator);
+void setPorts(Netlist* netlist, usize port, usize width, u64 value);
+void setClocks(Netlist* netlist, bool high);
+Simulator* createSimulator();
+void sendEvent(Simulator* simulator, Event event);
+void destroySimulator(Simulator* simulator);
+Netlist* compileSimulation(Project* project, Circuit* circuit, bool lowerWords, ModuleCache* cache);
+
+// file.c
+
+// Appends `thing` at `pointer` of `buffer`, for the project and netlist files
+#define PUT(thing) memcpy(&buffer[pointer], &thing, sizeof(thing)); pointer += sizeof(thing)
+
+usize getPortOffset(Circuit* circuit, ComponentRef ref);
+void saveProject(Project* project);
+Project loadProject(const char* path);
+void destroyProject(Project* project);
+
+// cache.c
+
+void saveNetlist(Netlist* netlist, u64 hash);
+bool loadNetlist(Project* project, Circuit* root, u64 hash, Netlist* netlist);
+
+// simulation.c
+
+// A circuit compiled for batch simulation, driven by the command line and
+// the embedding API rather than the simulator thread
+struct LogicolSimulation {
+  Netlist* netlist;
+  bool fourState;
+  u64 cycle;
+  usize numInputs;
+  usize* inputWidths;
+  usize numOutputs;
+  usize* outputWidths;
+  Coverage* coverage;
+};
+
+typedef struct LogicolSimulation Simulation;
+
+// Generated stimulus for the INPUTs, in blocks of 64 cycles laid out as
+// bit-planes like test vectors. The random modes run xoshiro256** seeded
+// from the seed and the block, so the vector of any cycle can be produced
+// again on its own. Each draw is a whole u64, one bit of the INPUTs in all
+// 64 cycles of a block.
+typedef enum StimulusMode {
+  STIMULUS_NONE = 0,
+  STIMULUS_UNIFORM = LOGICOL_UNIFORM,
+  STIMULUS_BIASED = LOGICOL_BIASED,
+  STIMULUS_WALKING_ONES = LOGICOL_WALKING_ONES,
+  STIMULUS_WALKING_ZEROS = LOGICOL_WALKING_ZEROS,
+  STIMULUS_COUNT = LOGICOL_COUNT,
+} StimulusMode;
+
+typedef struct {
+  StimulusMode mode;
+  u64 seed;
+  usize numInputs;
+  usize* widths;
+  u16* biases;
+  // The planes of the last block generated, a u64 per INPUT bit
+  usize numBits;
+  u64 block;
+  u64* planes;
+} Stimulus;
+
+Simulation* createSimulation(Project* project, Circuit* root, bool fourState, bool lowerWords, bool cache);
+void destroySimulation(Simulation* simulation);
+void setInputs(Simulation* simulation, const u64* values);
+void getOutputs(Simulation* simulation, u64* values, u64* unknown);
+void runCycle(Simulation* simulation);
+u16 getBias(double probability);
+Stimulus createStimulus(StimulusMode mode, u64 seed, usize numInputs, usize* widths);
+void destroyStimulus(Stimulus* stimulus);
+u64* getStimulusBlock(Stimulus* stimulus, u64 block);
+void generateStimulus(Stimulus* stimulus, u64 cycle, u64* values);
+
+#endif
@@ -0,0 +1,111 @@
+#include "logicol_core.h"
+
+// The embedding API of logicol.h, thin wrappers of simulation.c
+struct LogicolProject {
+  Project project;
+  char** names;
+};
+
+uint32_t logicol_version(void) {
+  return LOGICOL_API_VERSION;
+}
+
+LogicolProject* logicol_load(const char* path) {
+  Project project = loadProject(path);
+  if (!project.numCircuits) return NULL;
+  LogicolProject* loaded = malloc(sizeof(LogicolProject));
+  loaded->project = project;
+  loaded->names = malloc(sizeof(char*) * project.numCircuits);
+  for (usize i = 0; i < project.numCircuits; i++) {
+    loaded->names[i] = toCString(&project.circuits[i].name);
+  }
+  return loaded;
+}
+
+void logicol_free_project(LogicolProject* project) {
+  if (!project) return;
+  for (usize i = 0; i < project->project.numCircuits; i++) {
+    free(project->names[i]);
+  }
+  free(project->names);
+  destroyProject(&project->project);
+  free(project);
+}
+
+size_t logicol_num_circuits(const LogicolProject* project) {
+  return project->project.numCircuits;
+}
+
+const char* logicol_circuit_name(const LogicolProject* project, size_t index) {
+  return index < project->project.numCircuits ? project->names[index] : NULL;
+}
+
+LogicolSimulation* logicol_compile(LogicolProject* project, const char* name, uint32_t flags) {
+  Circuit* root = &project->project.circuits[0];
+  if (name) {
+    String string = fromCString(name);
+    root = findCircuit(&project->project, &string);
+    destroyString(&string);
+    if (!root) return NULL;
+  }
+  return createSimulation(&project->project, root, flags & LOGICOL_FOUR_STATE, flags & LOGICOL_LOWER_WORDS,
+                          flags & LOGICOL_CACHE);
+}
+
+void logicol_free_simulation(LogicolSimulation* simulation) {
+  if (simulation) destroySimulation(simulation);
+}
+
+size_t logicol_num_inputs(const LogicolSimulation* simulation) {
+  return simulation->numInputs;
+}
+
+size_t logicol_num_outputs(const LogicolSimulation* simulation) {
+  return simulation->numOutputs;
+}
+
+size_t logicol_input_width(const LogicolSimulation* simulation, size_t index) {
+  return index < simulation->numInputs ? simulation->inputWidths[index] : 0;
+}
+
+size_t logicol_output_width(const LogicolSimulation* simulation, size_t index) {
+  return index < simulation->numOutputs ? simulation->outputWidths[index] : 0;
+}
+
+void logicol_set_inputs(LogicolSimulation* simulation, const uint64_t* values) {
+  setInputs(simulation, values);
+}
+
+void logicol_get_outputs(const LogicolSimulation* simulation, uint64_t* values, uint64_t* unknown) {
+  getOutputs((Simulation*)simulation, values, unknown);
+}
+
+uint64_t logicol_run(LogicolSimulation* simulation, const uint64_t* inputs, uint64_t* outputs, uint64_t* unknown,
+                     size_t cycles) {
+  for (usize i = 0; i < cycles; i++) {
+    if (inputs) setInputs(simulation, &inputs[i * simulation->numInputs]);
+    runCycle(simulation);
+    if (outputs || unknown) {
+      getOutputs(simulation, outputs ? &outputs[i * simulation->numOutputs] : NULL,
+                 unknown ? &unknown[i * simulation->numOutputs] : NULL);
+    }
+  }
+  return simulation->cycle;
+}
+
+int logicol_generate(const LogicolSimulation* simulation, uint32_t mode, uint64_t seed, const double* biases,
+                     uint64_t first, uint64_t* inputs, size_t cycles) {
+  if (mode < LOGICOL_UNIFORM || mode > LOGICOL_COUNT) {
+    memset(inputs, 0, sizeof(u64) * simulation->numInputs * cycles);
+    return -1;
+  }
+  Stimulus stimulus = createStimulus(mode, seed, simulation->numInputs, simulation->inputWidths);
+  for (usize i = 0; biases && i < simulation->numInputs; i++) {
+    stimulus.biases[i] = getBias(biases[i]);
+  }
+  for (usize i = 0; i < cycles; i++) {
+    generateStimulus(&stimulus, first + i, &inputs[i * simulation->numInputs]);
+  }
+  destroyStimulus(&stimulus);
+  return 0;
+}
@@ -0,0 +1,323 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "logicol_core.h"
+
+// Compiled netlists are cached in NETLIST_DIRECTORY under the hash of the
+// design they were compiled from. Everything but the net values is used
+// straight from the mapped file, memories are looked up on the components
+// again and INPUTs are set to their current values after loading.
+#define NETLIST_DIRECTORY ".logicol"
+#define NETLIST_MAGIC 0x4c4e474c
+#define NETLIST_VERSION 2
+
+void getNetlistPath(char* path, u64 hash) {
+  sprintf(path, NETLIST_DIRECTORY "/%016llx.netlist", (unsigned long long)hash);
+}
+
+// Arrays in the file are padded to 8 bytes so they can be used in place
+#define ARRAY_SIZE(size) ((((usize)(size)) + 7) & ~(usize)7)
+
+usize putArray(char* buffer, usize pointer, const void* data, usize size) {
+  if (size) memcpy(&buffer[pointer], data, size);
+  return pointer + ARRAY_SIZE(size);
+}
+
+void saveNetlist(Netlist* netlist, u64 hash) {
+  usize numOperands = 0;
+  usize numResults = 0;
+  for (usize i = 0; i < netlist->numWords; i++) {
+    if (netlist->words[i].op == WORD_CALL) return; // Modules are not cached
+    numOperands += netlist->words[i].numOperands;
+    numResults += netlist->words[i].numResults;
+  }
+
+  u64 header[15] = {
+    NETLIST_MAGIC, NETLIST_VERSION, hash, netlist->numNodes, netlist->numLevels, netlist->numRoots,
+    netlist->numResolvers, netlist->numWords, netlist->numPorts, netlist->numClocks, netlist->needsFourState,
+    numOperands, numResults, netlist->numProbes, netlist->numPaths,
+  };
+  usize size = sizeof(header);
+  size += ARRAY_SIZE(netlist->numNodes) + 2 * ARRAY_SIZE(sizeof(u32) * netlist->numNodes) + 2 * sizeof(u64) * netlist->numNodes;
+  size += sizeof(usize) * (netlist->numLevels + 1);
+  size += ARRAY_SIZE(sizeof(u32) * netlist->numRoots);
+  size += ARRAY_SIZE(sizeof(u32) * netlist->numResolvers) + 2 * sizeof(usize) * netlist->numResolvers;
+  size += ARRAY_SIZE(sizeof(u32) * netlist->numPorts) + ARRAY_SIZE(sizeof(u32) * netlist->numClocks);
+  size += 9 * sizeof(u64) * netlist->numWords;
+  size += ARRAY_SIZE(sizeof(u32) * numOperands) + ARRAY_SIZE(sizeof(u32) * numResults);
+  size += sizeof(Probe) * netlist->numProbes + sizeof(InstancePath) * netlist->numPaths;
+
+  char* buffer = malloc(size);
+  memset(buffer, 0, size);
+  usize pointer = 0;
+  PUT(header);
+  pointer = putArray(buffer, pointer, netlist->types, netlist->numNodes);
+  pointer = putArray(buffer, pointer, netlist->left, sizeof(u32) * netlist->numNodes);
+  pointer = putArray(buffer, pointer, netlist->right, sizeof(u32) * netlist->numNodes);
+  pointer = putArray(buffer, pointer, netlist->one, sizeof(u64) * netlist->numNodes);
+  pointer = putArray(buffer, pointer, netlist->zero, sizeof(u64) * netlist->numNodes);
+  pointer = putArray(buffer, pointer, netlist->levels, sizeof(usize) * (netlist->numLevels + 1));
+  pointer = putArray(buffer, pointer, netlist->roots, sizeof(u32) * netlist->numRoots);
+  pointer = putArray(buffer, pointer, netlist->resolvers, sizeof(u32) * netlist->numResolvers);
+  pointer = putArray(buffer, pointer, netlist->resolverComponents, sizeof(usize) * netlist->numResolvers);
+  pointer = putArray(buffer, pointer, netlist->resolverCircuits, sizeof(usize) * netlist->numResolvers);
+  pointer = putArray(buffer, pointer, netlist->ports, sizeof(u32) * netlist->numPorts);
+  pointer = putArray(buffer, pointer, netlist->clocks, sizeof(u32) * netlist->numClocks);
+  for (usize i = 0; i < netlist->numWords; i++) {
+    Word* word = &netlist->words[i];
+    u64 fields[9] = {
+      word->op, word->width, word->numOperands, word->numResults, word->addressWidth, word->memorySize,
+      word->circuit, word->component, word->path,
+    };
+    PUT(fields);
+  }
+  for (usize i = 0; i < netlist->numWords; i++) {
+    memcpy(&buffer[pointer], netlist->words[i].operands, sizeof(u32) * netlist->words[i].numOperands);
+    pointer += sizeof(u32) * netlist->words[i].numOperands;
+  }
+  pointer = ARRAY_SIZE(pointer);
+  for (usize i = 0; i < netlist->numWords; i++) {
+    memcpy(&buffer[pointer], netlist->words[i].results, sizeof(u32) * netlist->words[i].numResults);
+    pointer += sizeof(u32) * netlist->words[i].numResults;
+  }
+  pointer = ARRAY_SIZE(pointer);
+  pointer = putArray(buffer, pointer, netlist->probes, sizeof(Probe) * netlist->numProbes);
+  pointer = putArray(buffer, pointer, netlist->paths, sizeof(InstancePath) * netlist->numPaths);
+
+  mkdir(NETLIST_DIRECTORY, 0755);
+  char path[64];
+  getNetlistPath(path, hash);
+  FILE* file = fopen(path, "wb");
+  if (!file) {
+    printf("Cannot write %s\n", path);
+    free(buffer);
+    return;
+  }
+  fwrite(buffer, size, 1, file);
+  fclose(file);
+  free(buffer);
+}
+
+// Points `data` at the next array of the mapping, false once it would run past
+// its end
+bool takeArray(void** data, u8* mapping, usize* pointer, usize size, usize mappingSize) {
+  if (size > mappingSize - *pointer) return false;
+  *data = &mapping[*pointer];
+  *pointer += ARRAY_SIZE(size);
+  if (*pointer > mappingSize) *pointer = mappingSize;
+  return true;
+}
+
+// Whether a net read from a cached netlist is one of its nodes, or the -1 of
+// a port that is not connected when `unused` is allowed
+bool isNetRef(Netlist* netlist, u32 net, bool unused) {
+  return net < netlist->numNodes || (unused && net == (u32)-1);
+}
+
+// Whether a component named by a cached netlist exists in the project
+bool isComponentRef(Project* project, usize circuit, usize component) {
+  return circuit != 0 && circuit <= project->numCircuits && component != 0 &&
+         component <= getCircuit(project, circuit)->numComponents;
+}
+
+// Whether a cached word op has every operand and result its evaluation reads,
+// stores only read whole ports of operands
+bool hasWordPins(Word* word) {
+  if (word->width < 1 || word->width > MAX_WIDTH || word->addressWidth > MAX_ADDRESS_WIDTH) return false;
+  if (word->op == WORD_STORE) return true;
+  if (word->op >= WORD_ROM) {
+    usize ports = word->op == WORD_RAM2 ? 2 : 1;
+    return word->numOperands >= ports * word->addressWidth && word->numResults >= ports * word->width;
+  }
+  usize valueWidth = getValueWidth(word->op, word->width);
+  return word->numOperands >= 2 * word->width + (word->op == WORD_MUX) && word->numResults >= valueWidth &&
+         word->numResults - valueWidth <= 64;
+}
+
+// Maps the cached netlist of a design, false when there is none or it does not
+// match the components any more. Everything a tick or report indexes with is
+// checked, so a stale or damaged file is compiled again rather than read out
+// of bounds.
+bool loadNetlist(Project* project, Circuit* root, u64 hash, Netlist* netlist) {
+  char path[64];
+  getNetlistPath(path, hash);
+  int file = open(path, O_RDONLY);
+  if (file < 0) return false;
+  struct stat info;
+  if (fstat(file, &info) != 0 || (usize)info.st_size < 15 * sizeof(u64)) {
+    close(file);
+    return false;
+  }
+  usize size = info.st_size;
+  u8* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+  close(file);
+  if (mapping == MAP_FAILED) return false;
+
+  u64 header[15];
+  memcpy(header, mapping, sizeof(header));
+  if (header[0] != NETLIST_MAGIC || header[1] != NETLIST_VERSION || header[2] != hash) {
+    munmap(mapping, size);
+    return false;
+  }
+
+  memset(netlist, 0, sizeof(Netlist));
+  netlist->numNodes = header[3];
+  netlist->numLevels = header[4];
+  netlist->numRoots = header[5];
+  netlist->numResolvers = header[6];
+  netlist->numWords = header[7];
+  netlist->numPorts = header[8];
+  netlist->numClocks = header[9];
+  netlist->needsFourState = header[10];
+  usize numOperands = header[11];
+  usize numResults = header[12];
+  netlist->numProbes = header[13];
+  netlist->numPaths = header[14];
+  netlist->mapping = mapping;
+  netlist->mappingSize = size;
+
+  usize pointer = sizeof(header);
+  void* one = NULL;
+  void* zero = NULL;
+  void* fields = NULL;
+  void* operands = NULL;
+  void* results = NULL;
+  bool valid = netlist->numNodes < ((usize)1 << 32) && netlist->numWords < ((usize)1 << 32) &&
+    takeArray((void**)&netlist->types, mapping, &pointer, netlist->numNodes, size) &&
+    takeArray((void**)&netlist->left, mapping, &pointer, sizeof(u32) * netlist->numNodes, size) &&
+    takeArray((void**)&netlist->right, mapping, &pointer, sizeof(u32) * netlist->numNodes, size) &&
+    takeArray(&one, mapping, &pointer, sizeof(u64) * netlist->numNodes, size) &&
+    takeArray(&zero, mapping, &pointer, sizeof(u64) * netlist->numNodes, size) &&
+    takeArray((void**)&netlist->levels, mapping, &pointer, sizeof(usize) * (netlist->numLevels + 1), size) &&
+    takeArray((void**)&netlist->roots, mapping, &pointer, sizeof(u32) * netlist->numRoots, size) &&
+    takeArray((void**)&netlist->resolvers, mapping, &pointer, sizeof(u32) * netlist->numResolvers, size) &&
+    takeArray((void**)&netlist->resolverComponents, mapping, &pointer, sizeof(usize) * netlist->numResolvers, size) &&
+    takeArray((void**)&netlist->resolverCircuits, mapping, &pointer, sizeof(usize) * netlist->numResolvers, size) &&
+    takeArray((void**)&netlist->ports, mapping, &pointer, sizeof(u32) * netlist->numPorts, size) &&
+    takeArray((void**)&netlist->clocks, mapping, &pointer, sizeof(u32) * netlist->numClocks, size) &&
+    takeArray(&fields, mapping, &pointer, 9 * sizeof(u64) * netlist->numWords, size) &&
+    takeArray(&operands, mapping, &pointer, sizeof(u32) * numOperands, size) &&
+    takeArray(&results, mapping, &pointer, sizeof(u32) * numResults, size) &&
+    takeArray((void**)&netlist->probes, mapping, &pointer, sizeof(Probe) * netlist->numProbes, size) &&
+    takeArray((void**)&netlist->paths, mapping, &pointer, sizeof(InstancePath) * netlist->numPaths, size);
+
+  valid = valid && netlist->numLevels > 0 && netlist->levels[0] == 0 &&
+          netlist->levels[netlist->numLevels] == netlist->numNodes;
+  for (usize i = 0; i < netlist->numLevels && valid; i++) {
+    valid = netlist->levels[i] <= netlist->levels[i + 1];
+  }
+  for (usize i = 0; i < netlist->numNodes && valid; i++) {
+    valid = netlist->types[i] <= CLOCK && netlist->left[i] < netlist->numNodes && netlist->right[i] < netlist->numNodes &&
+            (netlist->types[i] != WORD || netlist->left[i] < netlist->numWords);
+  }
+  for (usize i = 0; i < netlist->numRoots && valid; i++) {
+    valid = isNetRef(netlist, netlist->roots[i], false);
+  }
+  for (usize i = 0; i < netlist->numResolvers && valid; i++) {
+    valid = isNetRef(netlist, netlist->resolvers[i], false) &&
+            isComponentRef(project, netlist->resolverCircuits[i], netlist->resolverComponents[i]);
+  }
+  for (usize i = 0; i < netlist->numPorts && valid; i++) {
+    valid = isNetRef(netlist, netlist->ports[i], true);
+  }
+  for (usize i = 0; i < netlist->numClocks && valid; i++) {
+    valid = isNetRef(netlist, netlist->clocks[i], false);
+  }
+  for (usize i = 0; i < numOperands && valid; i++) {
+    valid = isNetRef(netlist, ((u32*)operands)[i], false);
+  }
+  for (usize i = 0; i < numResults && valid; i++) {
+    valid = isNetRef(netlist, ((u32*)results)[i], false);
+  }
+  for (usize i = 0; i < netlist->numPaths && valid; i++) {
+    InstancePath* path = &netlist->paths[i];
+    valid = path->parent <= netlist->numPaths && isComponentRef(project, path->circuit, path->component);
+  }
+  for (usize i = 0; i < netlist->numProbes && valid; i++) {
+    Probe* probe = &netlist->probes[i];
+    valid = isNetRef(netlist, probe->net, true) && probe->path <= netlist->numPaths &&
+            isComponentRef(project, probe->circuit, probe->component);
+  }
+  if (!valid) {
+    munmap(mapping, size);
+    return false;
+  }
+
+  netlist->one = malloc(sizeof(u64) * netlist->numNodes);
+  netlist->zero = malloc(sizeof(u64) * netlist->numNodes);
+  netlist->words = malloc(sizeof(Word) * netlist->numWords);
+  memset(netlist->words, 0, sizeof(Word) * netlist->numWords);
+  memcpy(netlist->one, one, sizeof(u64) * netlist->numNodes);
+  memcpy(netlist->zero, zero, sizeof(u64) * netlist->numNodes);
+
+  // Memories of instances get a copy per path, as when flattening
+  Memo copies = { 0 };
+  u64* field = fields;
+  usize nextOperand = 0;
+  usize nextResult = 0;
+  for (usize i = 0; i < netlist->numWords && valid; i++, field += 9) {
+    Word* word = &netlist->words[i];
+    word->op = field[0];
+    word->width = field[1];
+    word->numOperands = field[2];
+    word->numResults = field[3];
+    word->addressWidth = field[4];
+    word->memorySize = field[5];
+    word->circuit = field[6];
+    word->component = field[7];
+    word->path = field[8];
+    valid = word->op < WORD_CALL && word->numOperands <= numOperands - nextOperand &&
+            word->numResults <= numResults - nextResult && hasWordPins(word);
+    if (!valid) break;
+    word->operands = (u32*)operands + nextOperand;
+    word->results = (u32*)results + nextResult;
+    nextOperand += word->numOperands;
+    nextResult += word->numResults;
+    if (word->op < WORD_ROM) continue;
+
+    valid = word->circuit != 0 && word->circuit <= project->numCircuits;
+    Circuit* circuit = valid ? getCircuit(project, word->circuit) : NULL;
+    valid = valid && word->component != 0 && word->component <= circuit->numComponents;
+    Component* component = valid ? getComponent(circuit, word->component) : NULL;
+    valid = valid && isMemory(component) && component->memorySize == word->memorySize;
+    if (!valid) break;
+    word->memory = component->memory;
+    if (word->path != 0 && word->op != WORD_ROM) {
+      void** copy = findMemo(&copies, word->path, (usize)component, 0, 0);
+      if (!*copy) {
+        *copy = malloc(component->memorySize);
+        memcpy(*copy, component->memory, component->memorySize);
+        word->ownsMemory = true;
+      }
+      word->memory = *copy;
+    }
+  }
+  destroyMemo(&copies);
+  if (!valid) {
+    destroyNetlist(netlist);
+    return false;
+  }
+
+  netlist->numLanes = 64;
+  netlist->definition = root->id;
+  netlist->hash = 0;
+  for (usize i = 0; i < netlist->numWords; i++) {
+    if (netlist->words[i].op == WORD_STORE) netlist->hasStores = true;
+  }
+
+  // The cached net values hold the INPUTs of the compile that saved it
+  usize port = 0;
+  for (usize i = 0; i < root->numComponents; i++) {
+    Component* component = &root->components[i];
+    if (component->kind != KIND_INPUT) continue;
+    for (usize bit = 0; bit < component->width && port < netlist->numPorts; bit++, port++) {
+      u32 net = netlist->ports[port];
+      if (net == (u32)-1 || net >= netlist->numNodes) continue;
+      netlist->one[net] = (component->outputs[0] >> bit) & 1 ? ~(u64)0 : 0;
+      netlist->zero[net] = ~netlist->one[net];
+    }
+  }
+
+  return true;
+}
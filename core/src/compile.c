@@ -0,0 +1,760 @@
+#include "logicol_core.h"
+
+Node* createNode() {
+  Node* node = malloc(sizeof(Node));
+  memset(node, 0, sizeof(Node));
+  return node;
+}
+
+Node* createGate(NodeType type, Node* left, Node* right) {
+  Node* node = createNode();
+  node->type = type;
+  node->left = left;
+  node->right = right;
+  return node;
+}
+
+Node* createConstant(bool value) {
+  Node* node = createNode();
+  node->type = CONSTANT;
+  node->output = value;
+  return node;
+}
+
+usize hashMemoKey(usize a, usize b, usize c, usize d) {
+  u64 hash = 0x9e3779b97f4a7c15ull;
+  hash = (hash ^ a) * 0xff51afd7ed558ccdull;
+  hash = (hash ^ b) * 0xc4ceb9fe1a85ec53ull;
+  hash = (hash ^ c) * 0xff51afd7ed558ccdull;
+  hash = (hash ^ d) * 0xc4ceb9fe1a85ec53ull;
+  return hash ^ (hash >> 32);
+}
+
+// The slot for a key, created empty when missing. Only valid until the next call.
+void** findMemo(Memo* memo, usize a, usize b, usize c, usize d) {
+  if ((memo->count + 1) * 2 > memo->capacity) {
+    usize capacity = memo->capacity ? memo->capacity * 2 : 1024;
+    MemoEntry* entries = malloc(sizeof(MemoEntry) * capacity);
+    memset(entries, 0, sizeof(MemoEntry) * capacity);
+    for (usize i = 0; i < memo->capacity; i++) {
+      MemoEntry* entry = &memo->entries[i];
+      if (entry->key[1] == 0) continue;
+      usize slot = hashMemoKey(entry->key[0], entry->key[1], entry->key[2], entry->key[3]) & (capacity - 1);
+      while (entries[slot].key[1] != 0) slot = (slot + 1) & (capacity - 1);
+      entries[slot] = *entry;
+    }
+    free(memo->entries);
+    memo->entries = entries;
+    memo->capacity = capacity;
+  }
+
+  usize slot = hashMemoKey(a, b, c, d) & (memo->capacity - 1);
+  while (memo->entries[slot].key[1] != 0) {
+    usize* key = memo->entries[slot].key;
+    if (key[0] == a && key[1] == b && key[2] == c && key[3] == d) return &memo->entries[slot].value;
+    slot = (slot + 1) & (memo->capacity - 1);
+  }
+
+  MemoEntry* entry = &memo->entries[slot];
+  entry->key[0] = a;
+  entry->key[1] = b;
+  entry->key[2] = c;
+  entry->key[3] = d;
+  entry->value = NULL;
+  memo->count++;
+  return &entry->value;
+}
+
+void destroyMemo(Memo* memo) {
+  free(memo->entries);
+  memo->entries = NULL;
+  memo->count = 0;
+  memo->capacity = 0;
+}
+
+// Memo keys of a component are (instance path, component, output, bit), the
+// tag below takes the place of the output for its word op
+#define MEMO_WORD ((usize)-1)
+
+// With `modules` set instances are not inlined, each definition is compiled
+// once into a module netlist and instances call it
+typedef struct {
+  Memo nodes;
+  // Operand bits of word ops, keyed by pin rather than output
+  Memo operands;
+  Memo paths;
+  usize numPaths;
+  bool lowerWords;
+  Memo* modules;
+  bool module;
+} Compilation;
+
+typedef struct Parent Parent;
+typedef struct Parent {
+  Component* component;
+  Circuit* circuit;
+  Parent* parent;
+  Circuit* root;
+  usize path;
+  Compilation* compilation;
+} Parent;
+
+static Node compiling;
+
+WordOp getWordOp(Component* component) {
+  if (component->kind == KIND_SUB) return WORD_SUB;
+  if (component->kind == KIND_CMP) return WORD_CMP;
+  if (component->kind == KIND_MUX) return WORD_MUX;
+  if (component->kind == KIND_SHL) return WORD_SHL;
+  if (component->kind == KIND_SHR) return WORD_SHR;
+  if (component->kind == KIND_MUL) return WORD_MUL;
+  if (component->kind == KIND_ROM) return WORD_ROM;
+  if (component->kind == KIND_RAM) return WORD_RAM;
+  if (component->kind == KIND_RAM2) return WORD_RAM2;
+  return WORD_ADD;
+}
+
+// Result bits of a word op are its main output followed by its flags, the
+// carry or borrow of ADD and SUB, or equal then less than for CMP. Memories
+// return the data of each port and stores return nothing.
+usize getValueWidth(WordOp op, usize width) {
+  if (op == WORD_CMP || op == WORD_STORE) return 0;
+  return op == WORD_RAM2 ? 2 * width : width;
+}
+
+usize getNumFlags(WordOp op) {
+  if (op == WORD_ADD || op == WORD_SUB) return 1;
+  if (op == WORD_CMP) return 2;
+  return 0;
+}
+
+void compileComponent(Node* node, Project* project, Circuit* circuit, Input* input, usize bit, Parent* parent);
+
+void enterInstance(Parent* child, Parent* parent, Circuit* circuit, Component* component) {
+  Compilation* compilation = parent->compilation;
+  child->component = component;
+  child->circuit = circuit;
+  child->parent = parent;
+  child->root = parent->root;
+  child->compilation = compilation;
+  void** path = findMemo(&compilation->paths, parent->path, (usize)component, 0, 0);
+  if (!*path) *path = (void*)++compilation->numPaths;
+  child->path = (usize)*path;
+}
+
+Node* compileOperand(Project* project, Circuit* circuit, Component* component, usize pin, usize bit, Parent* parent) {
+  void** slot = findMemo(&parent->compilation->operands, parent->path, (usize)component, pin, bit);
+  if (*slot) return *slot;
+  Node* node = createNode();
+  compileComponent(node, project, circuit, &component->inputs[pin], bit, parent);
+  *findMemo(&parent->compilation->operands, parent->path, (usize)component, pin, bit) = node;
+  return node;
+}
+
+// Memory reads only depend on the addresses, the data and write enables go
+// to a separate store committed after the tick, so a memory breaks loops
+bool isWordOperand(Component* component, usize pin, bool store) {
+  if (!isMemory(component) || store) return true;
+  return component->kind == KIND_ROM || pin % 3 == 0;
+}
+
+Netlist* compileModule(Project* project, Circuit* definition, Compilation* compilation);
+
+// Returns NULL when the word depends on its own result
+Node* compileWord(Project* project, Circuit* circuit, Component* component, bool store, Parent* parent) {
+  void** slot = findMemo(&parent->compilation->nodes, parent->path, (usize)component, MEMO_WORD, store);
+  if (*slot == &compiling) {
+    char* name = toCString(&circuit->name);
+    printf("Combinational loop through %zu in %s\n", component->id, name);
+    free(name);
+    return NULL;
+  }
+  if (*slot) return *slot;
+  *slot = &compiling;
+
+  Netlist* module = NULL;
+  bool call = !store && !isWordOp(component) && !isMemory(component);
+  if (call) {
+    module = compileModule(project, getDefinition(project, component), parent->compilation);
+    if (!module) {
+      *findMemo(&parent->compilation->nodes, parent->path, (usize)component, MEMO_WORD, store) = NULL;
+      return NULL;
+    }
+  }
+
+  Node* word = createNode();
+  word->type = WORD;
+  word->op = store ? WORD_STORE : call ? WORD_CALL : getWordOp(component);
+  word->width = component->width;
+  word->module = module;
+  if (call) {
+    word->width = 0;
+    for (usize pin = 0; pin < component->numOutputs; pin++) {
+      word->width += getOutputWidth(project, component, pin);
+    }
+  }
+  word->component = component;
+  word->circuit = circuit;
+  word->path = parent->path;
+  word->numOperands = 0;
+  for (usize pin = 0; pin < component->numInputs; pin++) {
+    if (isWordOperand(component, pin, store)) word->numOperands += getInputWidth(project, component, pin);
+  }
+  word->operands = malloc(sizeof(Node*) * word->numOperands);
+
+  usize next = 0;
+  for (usize pin = 0; pin < component->numInputs; pin++) {
+    if (!isWordOperand(component, pin, store)) continue;
+    for (usize b = 0; b < getInputWidth(project, component, pin); b++) {
+      word->operands[next++] = compileOperand(project, circuit, component, pin, b, parent);
+    }
+  }
+
+  *findMemo(&parent->compilation->nodes, parent->path, (usize)component, MEMO_WORD, store) = word;
+  return word;
+}
+
+// Lowering builds the same word ops out of NANDs, for equivalence checking
+// and gate counts
+
+Node* lowerNot(Node* a) {
+  return createGate(NAND, a, a);
+}
+
+Node* lowerAnd(Node* a, Node* b) {
+  return lowerNot(createGate(NAND, a, b));
+}
+
+Node* lowerOr(Node* a, Node* b) {
+  return createGate(NAND, lowerNot(a), lowerNot(b));
+}
+
+Node* lowerXor(Node* a, Node* b) {
+  Node* both = createGate(NAND, a, b);
+  return createGate(NAND, createGate(NAND, a, both), createGate(NAND, b, both));
+}
+
+Node* lowerMux(Node* select, Node* a, Node* b) {
+  return createGate(NAND, createGate(NAND, a, lowerNot(select)), createGate(NAND, b, select));
+}
+
+// Ripple carry adder, `sum` gets `width` bits and the carry out is returned
+Node* lowerAdder(Node** a, Node** b, Node* carry, usize width, Node** sum) {
+  for (usize i = 0; i < width; i++) {
+    // sum may alias a, so read a[i] before overwriting it
+    Node* half = lowerXor(a[i], b[i]);
+    Node* generate = lowerAnd(a[i], b[i]);
+    sum[i] = lowerXor(half, carry);
+    carry = lowerOr(generate, lowerAnd(carry, half));
+  }
+  return carry;
+}
+
+void lowerShift(Node** a, Node** amount, usize width, bool left, Node** result) {
+  Node** current = malloc(sizeof(Node*) * width);
+  memcpy(current, a, sizeof(Node*) * width);
+
+  Node* overflow = NULL;
+  for (usize stage = 0; stage < width; stage++) {
+    usize distance = stage < 63 ? (usize)1 << stage : width;
+    if (distance >= width) {
+      overflow = overflow ? lowerOr(overflow, amount[stage]) : amount[stage];
+      continue;
+    }
+
+    Node** next = malloc(sizeof(Node*) * width);
+    for (usize i = 0; i < width; i++) {
+      Node* shifted = NULL;
+      if (left && i >= distance) shifted = current[i - distance];
+      if (!left && i + distance < width) shifted = current[i + distance];
+      next[i] = lowerMux(amount[stage], current[i], shifted ? shifted : createConstant(false));
+    }
+    free(current);
+    current = next;
+  }
+
+  for (usize i = 0; i < width; i++) {
+    result[i] = overflow ? lowerAnd(current[i], lowerNot(overflow)) : current[i];
+  }
+  free(current);
+}
+
+Node** lowerWord(Project* project, Circuit* circuit, Component* component, Parent* parent) {
+  void** slot = findMemo(&parent->compilation->nodes, parent->path, (usize)component, MEMO_WORD, 0);
+  if (*slot) return *slot;
+
+  WordOp op = getWordOp(component);
+  usize width = component->width;
+  Node** a = malloc(sizeof(Node*) * width);
+  Node** b = malloc(sizeof(Node*) * width);
+  for (usize i = 0; i < width; i++) {
+    a[i] = compileOperand(project, circuit, component, 0, i, parent);
+    b[i] = compileOperand(project, circuit, component, 1, i, parent);
+  }
+
+  Node** results = malloc(sizeof(Node*) * (getValueWidth(op, width) + getNumFlags(op)));
+  Node** scratch = malloc(sizeof(Node*) * width);
+  switch (op) {
+    case WORD_ADD:
+      results[width] = lowerAdder(a, b, createConstant(false), width, results);
+      break;
+    case WORD_SUB:
+    case WORD_CMP: {
+      Node** inverted = malloc(sizeof(Node*) * width);
+      for (usize i = 0; i < width; i++) inverted[i] = lowerNot(b[i]);
+      Node* carry = lowerAdder(a, inverted, createConstant(true), width, op == WORD_SUB ? results : scratch);
+      free(inverted);
+      if (op == WORD_SUB) {
+        results[width] = lowerNot(carry);
+        break;
+      }
+      Node* equal = lowerNot(lowerXor(a[0], b[0]));
+      for (usize i = 1; i < width; i++) equal = lowerAnd(equal, lowerNot(lowerXor(a[i], b[i])));
+      results[0] = equal;
+      results[1] = lowerNot(carry);
+      break;
+    }
+    case WORD_MUX: {
+      Node* select = compileOperand(project, circuit, component, 2, 0, parent);
+      for (usize i = 0; i < width; i++) results[i] = lowerMux(select, a[i], b[i]);
+      break;
+    }
+    case WORD_SHL:
+    case WORD_SHR:
+      lowerShift(a, b, width, op == WORD_SHL, results);
+      break;
+    case WORD_MUL: {
+      // Shift and add, one adder per bit of b
+      for (usize i = 0; i < width; i++) results[i] = lowerAnd(a[i], b[0]);
+      for (usize j = 1; j < width; j++) {
+        for (usize i = 0; i < width; i++) scratch[i] = i >= j ? lowerAnd(a[i - j], b[j]) : createConstant(false);
+        lowerAdder(results, scratch, createConstant(false), width, results);
+      }
+      break;
+    }
+    default: break; // Memories are never lowered
+  }
+
+  free(a);
+  free(b);
+  free(scratch);
+  *findMemo(&parent->compilation->nodes, parent->path, (usize)component, MEMO_WORD, 0) = results;
+  return results;
+}
+
+// Compiles `bit` of the net driving `input`. Multi-bit nets are blasted into
+// one node per bit here, everything before this point moves whole words. Each
+// bit of each output is compiled once per instance, later uses alias it.
+void compileComponent(Node* node, Project* project, Circuit* circuit, Input* input, usize bit, Parent* parent) {
+  memset(node, 0, sizeof(Node));
+  if (input->component == 0) {
+    node->type = FLOATING;
+    return;
+  }
+  Component* component = getComponent(circuit, input->component);
+  if (bit >= getOutputWidth(project, component, input->outputIndex)) {
+    node->type = FLOATING;
+    return;
+  }
+
+  Compilation* compilation = parent->compilation;
+  void** slot = findMemo(&compilation->nodes, parent->path, (usize)component, input->outputIndex, bit);
+  if (*slot == &compiling) {
+    char* name = toCString(&circuit->name);
+    printf("Combinational loop through %zu in %s\n", component->id, name);
+    free(name);
+    node->type = FLOATING;
+    return;
+  }
+  if (*slot) {
+    node->type = ALIAS;
+    node->left = *slot;
+    return;
+  }
+  *slot = &compiling;
+
+  if (component->kind == KIND_AND) {
+    Node* child = createNode();
+    node->left = child;
+    node->right = child;
+    child->left = createNode();
+    compileComponent(child->left, project, circuit, &component->inputs[0], bit, parent); 
+    child->right = createNode();
+    compileComponent(child->right, project, circuit, &component->inputs[1], bit, parent); 
+  } else if (component->kind == KIND_OR) {
+    node->left = createNode();
+    node->right = createNode();
+    Node* left = createNode();
+    node->left->left = left;
+    node->left->right = left;
+    compileComponent(left, project, circuit, &component->inputs[0], bit, parent); 
+    Node* right = createNode();
+    node->right->left = right;
+    node->right->right = right;
+    compileComponent(right, project, circuit, &component->inputs[1], bit, parent); 
+  } else if (component->kind == KIND_NOT) {
+    Node* child =  createNode();
+    node->left = child;
+    node->right = child;
+    compileComponent(child, project, circuit, &component->inputs[0], bit, parent);
+  } else if (component->kind == KIND_TRISTATE) {
+    node->type = TRISTATE;
+    node->left = createNode();
+    compileComponent(node->left, project, circuit, &component->inputs[0], bit, parent);
+    node->right = createNode();
+    compileComponent(node->right, project, circuit, &component->inputs[1], 0, parent);
+  } else if (component->kind == KIND_BUS) {
+    // Every driver folds into a chain of pairwise resolutions, Z being their identity
+    Node* chain = node;
+    for (usize i = 0; i + 1 < component->numInputs; i++) {
+      chain->type = RESOLVE;
+      chain->circuit = circuit;
+      chain->component = component;
+      chain->left = createNode();
+      compileComponent(chain->left, project, circuit, &component->inputs[i], bit, parent);
+      chain->right = createNode();
+      chain = chain->right;
+    }
+    compileComponent(chain, project, circuit, &component->inputs[component->numInputs - 1], bit, parent);
+  } else if (component->kind == KIND_CLOCK) {
+    node->type = CLOCK;
+    node->output = 0;
+  } else if (isMemory(component)) {
+    node->left = compileWord(project, circuit, component, false, parent);
+    node->type = node->left ? SLICE : FLOATING;
+    node->bit = input->outputIndex * component->width + bit;
+  } else if (isWordOp(component)) {
+    WordOp op = getWordOp(component);
+    usize result = bit + (input->outputIndex > 0 ? getValueWidth(op, component->width) + input->outputIndex - 1 : 0);
+    if (op == WORD_CMP) result = input->outputIndex;
+    if (compilation->lowerWords) {
+      node->type = ALIAS;
+      node->left = lowerWord(project, circuit, component, parent)[result];
+    } else {
+      node->type = SLICE;
+      node->bit = result;
+      node->left = compileWord(project, circuit, component, false, parent);
+      if (!node->left) node->type = FLOATING;
+    }
+  } else if (component->kind == KIND_SPLIT) {
+    compileComponent(node, project, circuit, &component->inputs[0], input->outputIndex, parent);
+  } else if (component->kind == KIND_MERGE) {
+    compileComponent(node, project, circuit, &component->inputs[bit], 0, parent);
+  } else if (component->kind == KIND_INPUT) {
+    if (circuit == parent->root) {
+      node->type = compilation->module ? PORT : INPUT;
+      node->output = (component->outputs[0] >> bit) & 1;
+      node->component = component;
+      node->bit = bit;
+    } else {
+      usize numInput = 0;
+      for (usize i = 0; i < circuit->numComponents; i++) {
+        if (circuit->components[i].kind == KIND_INPUT) {
+          if (circuit->components[i].id == input->component) break;
+          numInput++;
+        }
+      }
+
+      compileComponent(node, project, parent->circuit, &parent->component->inputs[numInput], bit, parent->parent);
+    }
+  } else if (compilation->modules && getDefinition(project, component)) {
+    node->left = compileWord(project, circuit, component, false, parent);
+    node->type = node->left ? SLICE : FLOATING;
+    node->bit = bit;
+    for (usize pin = 0; pin < input->outputIndex; pin++) {
+      node->bit += getOutputWidth(project, component, pin);
+    }
+  } else {
+    Circuit* definition = getDefinition(project, component);
+    Component* port = definition ? getPort(definition, KIND_OUTPUT, input->outputIndex) : NULL;
+    if (!definition) {
+      char* name = toCString(&component->name);
+      char* owner = toCString(&circuit->name);
+      printf("No circuit %s for %zu in %s\n", name, component->id, owner);
+      free(name);
+      free(owner);
+    }
+    if (port) {
+      Parent p;
+      enterInstance(&p, parent, circuit, component);
+      compileComponent(node, project, definition, &port->inputs[0], bit, &p);
+    }
+  }
+
+  if (node->type == NAND && !node->left) {
+    node->type = FLOATING; // Nothing we know how to compile drives this
+  }
+  *findMemo(&compilation->nodes, parent->path, (usize)component, input->outputIndex, bit) = node;
+}
+
+// Collects the stores of every RAM in every instance below `circuit`
+void compileMemories(Project* project, Circuit* circuit, Parent* parent, Tree* tree) {
+  for (usize i = 0; i < circuit->numComponents; i++) {
+    Component* component = &circuit->components[i];
+    if (component->kind == KIND_RAM || component->kind == KIND_RAM2) {
+      Node* store = compileWord(project, circuit, component, true, parent);
+      if (!store) continue;
+      tree->numMemories++;
+      tree->memories = realloc(tree->memories, sizeof(Node*) * tree->numMemories);
+      tree->memories[tree->numMemories - 1] = store;
+      continue;
+    }
+
+    Circuit* definition = getDefinition(project, component);
+    if (!definition) continue;
+
+    // Instances are called even when nothing reads them if they have RAMs
+    if (parent->compilation->modules) {
+      Netlist* module = compileModule(project, definition, parent->compilation);
+      if (!module || !module->hasStores) continue;
+      Node* call = compileWord(project, circuit, component, false, parent);
+      if (!call) continue;
+      tree->numMemories++;
+      tree->memories = realloc(tree->memories, sizeof(Node*) * tree->numMemories);
+      tree->memories[tree->numMemories - 1] = call;
+      continue;
+    }
+
+    bool recursive = definition == circuit || definition == parent->root;
+    for (Parent* p = parent; p && !recursive; p = p->parent) recursive = p->circuit == definition;
+    if (recursive) continue;
+
+    Parent child;
+    enterInstance(&child, parent, circuit, component);
+    compileMemories(project, definition, &child, tree);
+  }
+}
+
+// A probe for every output bit compiled, and the instances they were
+// compiled in
+void collectProbes(Project* project, Compilation* compilation, Tree* tree) {
+  tree->numProbes = 0;
+  tree->probes = malloc(sizeof(Probe) * (compilation->nodes.count + 1));
+  tree->probeNodes = malloc(sizeof(Node*) * (compilation->nodes.count + 1));
+  for (usize i = 0; i < compilation->nodes.capacity; i++) {
+    MemoEntry* entry = &compilation->nodes.entries[i];
+    if (entry->key[1] == 0 || entry->key[2] == MEMO_WORD || !entry->value || entry->value == &compiling) continue;
+    Component* component = (Component*)entry->key[1];
+    Probe* probe = &tree->probes[tree->numProbes];
+    probe->net = (u32)-1;
+    probe->path = entry->key[0];
+    probe->output = entry->key[2];
+    probe->bit = entry->key[3];
+    probe->circuit = findOwner(project, component)->id;
+    probe->component = component->id;
+    tree->probeNodes[tree->numProbes++] = entry->value;
+  }
+
+  tree->numPaths = compilation->numPaths;
+  tree->paths = malloc(sizeof(InstancePath) * (compilation->numPaths + 1));
+  for (usize i = 0; i < compilation->paths.capacity; i++) {
+    MemoEntry* entry = &compilation->paths.entries[i];
+    if (entry->key[1] == 0) continue;
+    Component* component = (Component*)entry->key[1];
+    InstancePath* path = &tree->paths[(usize)entry->value - 1];
+    path->parent = entry->key[0];
+    path->circuit = findOwner(project, component)->id;
+    path->component = component->id;
+  }
+}
+
+// One root per OUTPUT bit, in component order
+Tree compileTree(Project* project, Circuit* root, bool lowerWords, Memo* modules, bool module) {
+  Compilation compilation;
+  memset(&compilation, 0, sizeof(Compilation));
+  compilation.lowerWords = lowerWords;
+  compilation.modules = modules;
+  compilation.module = module;
+
+  usize numRoots = 0;
+  for (usize i = 0; i < root->numComponents; i++) {
+    if (root->components[i].kind == KIND_OUTPUT) {
+      numRoots += root->components[i].width;
+    }
+  }
+
+  Tree tree;
+  tree.numRoots = numRoots;
+  tree.roots = malloc(sizeof(Node) * numRoots);
+  tree.circuit = root;
+  tree.modules = NULL;
+
+  usize next = 0;
+  for (usize i = 0; i < root->numComponents; i++) {
+    if (root->components[i].kind == KIND_OUTPUT) {
+      for (usize bit = 0; bit < root->components[i].width; bit++) {
+        Parent parent;
+        memset(&parent, 0, sizeof(Parent));
+        parent.root = root;
+        parent.compilation = &compilation;
+        compileComponent(&tree.roots[next++], project, root, &root->components[i].inputs[0], bit, &parent);
+      }
+    }
+  }
+
+  tree.numMemories = 0;
+  tree.memories = NULL;
+  Parent parent;
+  memset(&parent, 0, sizeof(Parent));
+  parent.root = root;
+  parent.compilation = &compilation;
+  compileMemories(project, root, &parent, &tree);
+
+  collectProbes(project, &compilation, &tree);
+  for (usize i = 0; i < compilation.nodes.capacity && lowerWords; i++) {
+    MemoEntry* entry = &compilation.nodes.entries[i];
+    if (entry->key[1] != 0 && entry->key[2] == MEMO_WORD && isWordOp((Component*)entry->key[1])) free(entry->value);
+  }
+  destroyMemo(&compilation.nodes);
+  destroyMemo(&compilation.operands);
+  destroyMemo(&compilation.paths);
+
+  return tree;
+}
+
+// A hierarchical tree calls instances instead of inlining them, the modules
+// it calls are owned by the netlist it flattens into
+Tree compileProject(Project* project, Circuit* root, bool lowerWords, bool hierarchical) {
+  Memo* modules = NULL;
+  if (hierarchical) {
+    modules = malloc(sizeof(Memo));
+    memset(modules, 0, sizeof(Memo));
+  }
+  Tree tree = compileTree(project, root, lowerWords, modules, false);
+  tree.modules = modules;
+  return tree;
+}
+
+u64 getCircuitHash(Project* project, Circuit* circuit);
+
+// Each definition is compiled once, with its INPUTs as PORTs set by callers
+Netlist* compileModule(Project* project, Circuit* definition, Compilation* compilation) {
+  void** slot = findMemo(compilation->modules, 0, definition->id, 0, 0);
+  if (*slot == &compiling) {
+    char* name = toCString(&definition->name);
+    printf("%s contains an instance of itself\n", name);
+    free(name);
+    return NULL;
+  }
+  if (*slot) return *slot;
+  *slot = &compiling;
+
+  Netlist* module = malloc(sizeof(Netlist));
+  *module = flattenTree(compileTree(project, definition, compilation->lowerWords, compilation->modules, true));
+  module->hash = getCircuitHash(project, definition);
+  *findMemo(compilation->modules, 0, definition->id, 0, 0) = module;
+  return module;
+}
+
+// The Merkle hash of a circuit, its own content combined with the hashes of
+// the definitions it instantiates. Cached on the circuit until an edit below
+// it invalidates it.
+u64 getCircuitHash(Project* project, Circuit* circuit) {
+  if (circuit->hashValid) return circuit->hash;
+  if (circuit->hashBusy) return 0; // Instantiates itself
+  circuit->hashBusy = true;
+
+  u64 hash = circuit->contentHash;
+  hash = hashBytes(hash, circuit->name.data, circuit->name.length);
+  for (usize i = 0; i < circuit->numComponents; i++) {
+    Component* component = &circuit->components[i];
+    if (component->kind != KIND_CIRCUIT) continue;
+    Circuit* definition = getDefinition(project, component);
+    if (!definition) continue;
+    u64 child = getCircuitHash(project, definition);
+    HASH(component->id);
+    HASH(child);
+  }
+
+  circuit->hashBusy = false;
+  circuit->hash = hash;
+  circuit->hashValid = true;
+  return hash;
+}
+
+// Keys the netlist compiled from a root
+u64 getDesignHash(Project* project, Circuit* root, bool lowerWords) {
+  u64 hash = getCircuitHash(project, root);
+  HASH(lowerWords);
+  return hash;
+}
+
+bool isModuleCurrent(Project* project, Netlist* module) {
+  if (module->definition > project->numCircuits) return false;
+  return getCircuitHash(project, getCircuit(project, module->definition)) == module->hash;
+}
+
+// Retires the modules whose definition no longer hashes the same
+void refreshModules(Project* project, ModuleCache* cache, bool lowerWords) {
+  bool reset = cache->lowerWords != lowerWords;
+  Memo modules = { 0 };
+  for (usize i = 0; i < cache->modules.capacity; i++) {
+    MemoEntry* entry = &cache->modules.entries[i];
+    if (entry->key[1] == 0 || !entry->value) continue;
+    if (!reset && isModuleCurrent(project, entry->value)) {
+      *findMemo(&modules, 0, entry->key[1], 0, 0) = entry->value;
+      continue;
+    }
+    cache->numRetired++;
+    cache->retired = realloc(cache->retired, sizeof(Netlist*) * cache->numRetired);
+    cache->retired[cache->numRetired - 1] = entry->value;
+  }
+  destroyMemo(&cache->modules);
+  cache->modules = modules;
+  cache->lowerWords = lowerWords;
+}
+
+void destroyModules(Netlist** modules, usize numModules) {
+  for (usize i = 0; i < numModules; i++) {
+    destroyNetlist(modules[i]);
+    free(modules[i]);
+  }
+  free(modules);
+}
+
+void destroyModuleCache(ModuleCache* cache) {
+  for (usize i = 0; i < cache->modules.capacity; i++) {
+    Netlist* module = cache->modules.entries[i].value;
+    if (cache->modules.entries[i].key[1] == 0 || !module) continue;
+    destroyNetlist(module);
+    free(module);
+  }
+  destroyMemo(&cache->modules);
+  destroyModules(cache->retired, cache->numRetired);
+  cache->retired = NULL;
+  cache->numRetired = 0;
+}
+
+// Compiles a hierarchical netlist whose modules stay in the cache, only the
+// root circuit and the modules out of date are compiled again
+Netlist compileIncremental(Project* project, Circuit* root, ModuleCache* cache, bool lowerWords) {
+  refreshModules(project, cache, lowerWords);
+  usize kept = cache->modules.count;
+  Netlist netlist = flattenTree(compileTree(project, root, lowerWords, &cache->modules, false));
+  instantiateWords(&netlist);
+  cache->numCompiled = cache->modules.count - kept;
+  return netlist;
+}
+
+// Copies the RAM contents of a netlist into the one rebuilt to replace it, for
+// the memories that are still there with the same size
+void transferMemories(Netlist* from, Netlist* to) {
+  Memo words = { 0 };
+  for (usize i = 0; i < from->numWords; i++) {
+    Word* word = &from->words[i];
+    if (word->component == 0) continue;
+    *findMemo(&words, word->path, word->component, word->circuit, word->op) = word;
+  }
+
+  for (usize i = 0; i < to->numWords; i++) {
+    Word* word = &to->words[i];
+    if (word->component == 0) continue;
+    Word* old = *findMemo(&words, word->path, word->component, word->circuit, word->op);
+    if (!old) continue;
+    if (word->op != WORD_ROM && word->memory && old->memory && word->memorySize == old->memorySize) {
+      memcpy(word->memory, old->memory, word->memorySize);
+    }
+    if (word->instance && old->instance) transferMemories(old->instance, word->instance);
+  }
+  destroyMemo(&words);
+}
@@ -0,0 +1,156 @@
+#include "logicol_core.h"
+
+Coverage* createCoverage(Netlist* netlist) {
+  Coverage* coverage = malloc(sizeof(Coverage));
+  memset(coverage, 0, sizeof(Coverage));
+  coverage->root = netlist->definition;
+  coverage->numProbes = netlist->numProbes;
+  coverage->probes = malloc(sizeof(Probe) * (netlist->numProbes + 1));
+  memcpy(coverage->probes, netlist->probes, sizeof(Probe) * netlist->numProbes);
+  coverage->numPaths = netlist->numPaths;
+  coverage->paths = malloc(sizeof(InstancePath) * (netlist->numPaths + 1));
+  memcpy(coverage->paths, netlist->paths, sizeof(InstancePath) * netlist->numPaths);
+
+  coverage->nets = malloc(sizeof(u32) * (netlist->numProbes + 1));
+  coverage->probeNets = malloc(sizeof(u32) * (netlist->numProbes + 1));
+  u32* seen = malloc(sizeof(u32) * (netlist->numNodes + 1));
+  memset(seen, 0xff, sizeof(u32) * (netlist->numNodes + 1));
+  for (usize i = 0; i < coverage->numProbes; i++) {
+    u32 net = coverage->probes[i].net;
+    coverage->probeNets[i] = (u32)-1;
+    if (net == (u32)-1) continue;
+    if (seen[net] == (u32)-1) {
+      seen[net] = coverage->numNets;
+      coverage->nets[coverage->numNets++] = net;
+    }
+    coverage->probeNets[i] = seen[net];
+  }
+  free(seen);
+
+  coverage->states = malloc(sizeof(CoverageNet) * (coverage->numNets + 1));
+  for (usize i = 0; i < coverage->numNets; i++) {
+    coverage->states[i].previous = 0;
+    atomic_init(&coverage->states[i].toggles, 0);
+    atomic_init(&coverage->states[i].rises, 0);
+    atomic_init(&coverage->states[i].falls, 0);
+  }
+  atomic_init(&coverage->samples, 0);
+  atomic_init(&coverage->detached, false);
+  return coverage;
+}
+
+void destroyCoverage(Coverage* coverage) {
+  free(coverage->probes);
+  free(coverage->paths);
+  free(coverage->nets);
+  free(coverage->probeNets);
+  free(coverage->states);
+  free(coverage);
+}
+
+// Set bits of a word. Without -mpopcnt __builtin_popcountll is a library
+// call, this is a dozen instructions inline.
+u64 countBits(u64 word) {
+  word -= (word >> 1) & 0x5555555555555555ull;
+  word = (word & 0x3333333333333333ull) + ((word >> 2) & 0x3333333333333333ull);
+  word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0full;
+  return (word * 0x0101010101010101ull) >> 56;
+}
+
+// The first sample only sets the previous values
+void sampleCoverage(Coverage* coverage, Netlist* netlist) {
+  u64 lanes = netlist->numLanes >= 64 ? ~(u64)0 : ((u64)1 << netlist->numLanes) - 1;
+  u64 samples = atomic_load_explicit(&coverage->samples, memory_order_relaxed);
+  u64* one = netlist->one;
+  for (usize i = 0; i < coverage->numNets; i++) {
+    CoverageNet* state = &coverage->states[i];
+    u64 value = one[coverage->nets[i]];
+    u64 changed = (value ^ state->previous) & lanes;
+    state->previous = value;
+    if (!changed || samples == 0) continue;
+    u64 toggles = atomic_load_explicit(&state->toggles, memory_order_relaxed);
+    atomic_store_explicit(&state->toggles, toggles + countBits(changed), memory_order_relaxed);
+    u64 rises = atomic_load_explicit(&state->rises, memory_order_relaxed);
+    atomic_store_explicit(&state->rises, rises | (changed & value), memory_order_relaxed);
+    u64 falls = atomic_load_explicit(&state->falls, memory_order_relaxed);
+    atomic_store_explicit(&state->falls, falls | (changed & ~value), memory_order_relaxed);
+  }
+  atomic_store_explicit(&coverage->samples, samples + 1, memory_order_relaxed);
+}
+
+// Probe `probe` has gone both 0 to 1 and 1 to 0
+bool isProbeCovered(Coverage* coverage, usize probe) {
+  u32 net = coverage->probeNets[probe];
+  if (net == (u32)-1) return false;
+  return atomic_load_explicit(&coverage->states[net].rises, memory_order_relaxed) &&
+         atomic_load_explicit(&coverage->states[net].falls, memory_order_relaxed);
+}
+
+u64 getProbeToggles(Coverage* coverage, usize probe) {
+  u32 net = coverage->probeNets[probe];
+  return net == (u32)-1 ? 0 : atomic_load_explicit(&coverage->states[net].toggles, memory_order_relaxed);
+}
+
+typedef struct {
+  usize bits;
+  usize covered;
+  u64 toggles;
+} CoverageTotal;
+
+void printInstanceName(FILE* file, Project* project, Coverage* coverage, usize path) {
+  if (path == 0) {
+    char* name = toCString(&getCircuit(project, coverage->root)->name);
+    fprintf(file, "%s", name);
+    free(name);
+    return;
+  }
+  InstancePath* instance = &coverage->paths[path - 1];
+  printInstanceName(file, project, coverage, instance->parent);
+  Component* component = getComponent(getCircuit(project, instance->circuit), instance->component);
+  char* name = toCString(&component->name);
+  fprintf(file, " > %s %zu", name, component->id);
+  free(name);
+}
+
+void printTotal(FILE* file, CoverageTotal* total) {
+  fprintf(file, "%zu of %zu bits toggled both ways (%.1f%%), %llu toggles\n", total->covered, total->bits,
+          total->bits ? 100.0 * total->covered / total->bits : 100.0, (unsigned long long)total->toggles);
+}
+
+// Totals per definition, over all its instances, and per instance
+void reportCoverage(FILE* file, Project* project, Coverage* coverage) {
+  CoverageTotal* circuits = malloc(sizeof(CoverageTotal) * (project->numCircuits + 1));
+  CoverageTotal* paths = malloc(sizeof(CoverageTotal) * (coverage->numPaths + 1));
+  memset(circuits, 0, sizeof(CoverageTotal) * (project->numCircuits + 1));
+  memset(paths, 0, sizeof(CoverageTotal) * (coverage->numPaths + 1));
+  for (usize i = 0; i < coverage->numProbes; i++) {
+    Probe* probe = &coverage->probes[i];
+    if (probe->circuit == 0 || probe->circuit > project->numCircuits || probe->path > coverage->numPaths) continue;
+    bool covered = isProbeCovered(coverage, i);
+    u64 toggles = getProbeToggles(coverage, i);
+    CoverageTotal* totals[2] = { &circuits[probe->circuit], &paths[probe->path] };
+    for (usize j = 0; j < 2; j++) {
+      totals[j]->bits++;
+      totals[j]->covered += covered;
+      totals[j]->toggles += toggles;
+    }
+  }
+
+  fprintf(file, "Toggle coverage after %llu ticks\n", (unsigned long long)atomic_load(&coverage->samples));
+  for (usize i = 0; i < project->numCircuits; i++) {
+    if (!circuits[i + 1].bits) continue;
+    char* name = toCString(&project->circuits[i].name);
+    fprintf(file, "  circuit %s: ", name);
+    free(name);
+    printTotal(file, &circuits[i + 1]);
+  }
+  for (usize i = 0; i <= coverage->numPaths; i++) {
+    if (!paths[i].bits) continue;
+    fprintf(file, "  instance ");
+    printInstanceName(file, project, coverage, i);
+    fprintf(file, ": ");
+    printTotal(file, &paths[i]);
+  }
+  free(circuits);
+  free(paths);
+}
@@ -0,0 +1,339 @@
+#include "logicol_core.h"
+
+// Index of the first port of an INPUT, the ports of a netlist are the bits of
+// the root's INPUTs in order
+usize getPortOffset(Circuit* circuit, ComponentRef ref) {
+  usize offset = 0;
+  for (usize i = 0; i < circuit->numComponents && circuit->components[i].id != ref; i++) {
+    if (circuit->components[i].kind == KIND_INPUT) offset += circuit->components[i].width;
+  }
+  return offset;
+}
+
+usize getComponentSize(Component* component) {
+  usize size = 0;
+  size += sizeof(component->id);
+  size += sizeof(component->pos);
+  size += sizeof(component->name.length);
+  size += component->name.length;
+  size += sizeof(component->numInputs);
+  size += sizeof(Input) * component->numInputs;
+  size += sizeof(component->numOutputs);
+  size += sizeof(u64) * component->numOutputs;
+  size += sizeof(component->width);
+  size += sizeof(component->addressWidth);
+  size += sizeof(component->image.length);
+  size += component->image.length;
+  return size;
+}
+
+usize getCircuitSize(Circuit* circuit) {
+  usize size = 0;
+  size += sizeof(circuit->id);
+  size += sizeof(circuit->name.length);
+  size += circuit->name.length;
+  size += sizeof(circuit->numComponents);
+  for (usize i = 0; i < circuit->numComponents; i++) {
+    size += getComponentSize(&circuit->components[i]);
+  }
+  return size;
+}
+
+// Files start with FILE_MAGIC and a version, files without it predate
+// versioning and store one bool per output and no widths. Version 2 adds the
+// address width and ROM image path of memories, RAM contents are not saved.
+#define FILE_MAGIC 0x4c43474c
+#define FILE_VERSION 2
+
+void saveComponent(Component* component, char* buffer) {
+  usize pointer = 0;
+  PUT(component->id);
+  PUT(component->pos);
+  PUT(component->name.length);
+  memcpy(&buffer[pointer], component->name.data, component->name.length);
+  pointer += component->name.length;
+  PUT(component->numInputs);
+  memcpy(&buffer[pointer], component->inputs, sizeof(Input) * component->numInputs);
+  pointer += sizeof(Input) * component->numInputs;
+  PUT(component->numOutputs);
+  memcpy(&buffer[pointer], component->outputs, sizeof(u64) * component->numOutputs);
+  pointer += sizeof(u64) * component->numOutputs;
+  PUT(component->width);
+  PUT(component->addressWidth);
+  PUT(component->image.length);
+  if (component->image.length) memcpy(&buffer[pointer], component->image.data, component->image.length);
+  pointer += component->image.length;
+}
+
+void saveCircuit(Circuit* circuit, char* buffer) {
+  usize pointer = 0;
+  PUT(circuit->id);
+  PUT(circuit->name.length);
+  memcpy(&buffer[pointer], circuit->name.data, circuit->name.length);
+  pointer += circuit->name.length;
+  PUT(circuit->numComponents);
+  for (usize i = 0; i < circuit->numComponents; i++) {
+    saveComponent(&circuit->components[i], &buffer[pointer]);
+    pointer += getComponentSize(&circuit->components[i]);
+  }
+}
+
+void saveProject(Project* project) {
+  usize size = 0;
+  size += 8; // FILE_MAGIC and FILE_VERSION
+  size += 8; // project->numCircuits
+  for (usize i = 0; i < project->numCircuits; i++) {
+    size += getCircuitSize(&project->circuits[i]);
+  }
+  printf("Size: %zu\n", size);
+
+  char* buffer = malloc(size);
+  usize pointer = 0;
+  u32 magic = FILE_MAGIC;
+  u32 version = FILE_VERSION;
+  PUT(magic);
+  PUT(version);
+  PUT(project->numCircuits);
+  for (usize i = 0; i < project->numCircuits; i++) {
+    saveCircuit(&project->circuits[i], &buffer[pointer]);
+    pointer += getCircuitSize(&project->circuits[i]);
+  }
+
+  FILE* file = fopen("test.logic", "wb+");
+  fwrite(buffer, size, 1, file);
+  fclose(file);
+
+  free(buffer);
+}
+
+// Reads are checked against the `size` bytes of the buffer, a loader returns
+// the bytes it used or 0 when the file is truncated or damaged. Counts are
+// checked before anything is allocated for them.
+#define FITS(count, bytes) ((count) <= (size - pointer) / (bytes))
+#define GET(thing) if (!FITS(1, sizeof(thing))) return 0; memcpy(&thing, &buffer[pointer], sizeof(thing)); pointer += sizeof(thing)
+
+usize loadString(String* string, char* buffer, usize size) {
+  usize pointer = 0;
+  GET(string->length);
+  if (!FITS(string->length, 1)) return 0;
+  string->data = malloc(string->length);
+  if (string->length && !string->data) return 0;
+  memcpy(string->data, &buffer[pointer], string->length);
+  return pointer + string->length;
+}
+
+usize loadComponent(Component* component, char* buffer, usize size, u32 version) {
+  usize pointer = 0;
+  GET(component->id);
+  GET(component->pos);
+  usize used = loadString(&component->name, &buffer[pointer], size - pointer);
+  if (!used) return 0;
+  pointer += used;
+  component->kind = getKind(&component->name);
+  GET(component->numInputs);
+  if (!FITS(component->numInputs, sizeof(Input))) return 0;
+  component->inputs = malloc(sizeof(Input) * component->numInputs);
+  if (component->numInputs && !component->inputs) return 0;
+  memcpy(component->inputs, &buffer[pointer], sizeof(Input) * component->numInputs);
+  pointer += sizeof(Input) * component->numInputs;
+  GET(component->numOutputs);
+  if (!FITS(component->numOutputs, version == 0 ? 1 : sizeof(u64))) return 0;
+  component->outputs = malloc(sizeof(u64) * component->numOutputs);
+  if (component->numOutputs && !component->outputs) return 0;
+  if (version == 0) {
+    for (usize i = 0; i < component->numOutputs; i++) {
+      component->outputs[i] = buffer[pointer++] != 0;
+    }
+    component->width = 1;
+  } else {
+    memcpy(component->outputs, &buffer[pointer], sizeof(u64) * component->numOutputs);
+    pointer += sizeof(u64) * component->numOutputs;
+    GET(component->width);
+  }
+  if (version >= 2) {
+    GET(component->addressWidth);
+    used = loadString(&component->image, &buffer[pointer], size - pointer);
+    if (!used) return 0;
+    pointer += used;
+  }
+  if (component->width < 1 || component->width > MAX_WIDTH || component->addressWidth > MAX_ADDRESS_WIDTH) return 0;
+  if (component->kind == KIND_ROM) {
+    mapImage(component);
+  } else if (isMemory(component)) {
+    updateMemory(component);
+  }
+  return pointer;
+}
+
+// Whether a component has the pins compileComponent reads for its kind, an
+// instance needs those of the ports of its definition
+bool hasPins(Project* project, Component* component) {
+  Kind kind = component->kind;
+  usize inputs = 0;
+  usize outputs = 1;
+  if (kind == KIND_NOT || kind == KIND_BUS || kind == KIND_SPLIT || kind == KIND_OUTPUT || kind == KIND_ROM) inputs = 1;
+  if (kind == KIND_AND || kind == KIND_OR || kind == KIND_TRISTATE) inputs = 2;
+  if (isWordOp(component)) inputs = kind == KIND_MUX ? 3 : 2;
+  if (kind == KIND_ADD || kind == KIND_SUB || kind == KIND_CMP) outputs = 2;
+  if (kind == KIND_RAM) inputs = 3;
+  if (kind == KIND_RAM2) {
+    inputs = 6;
+    outputs = 2;
+  }
+  if (kind == KIND_MERGE) inputs = component->width;
+  if (kind == KIND_SPLIT) outputs = component->width;
+  if (kind == KIND_OUTPUT || kind == KIND_CIRCUIT) outputs = 0;
+
+  Circuit* definition = kind == KIND_CIRCUIT ? getDefinition(project, component) : NULL;
+  if (definition) {
+    outputs = 0;
+    for (usize i = 0; i < definition->numComponents; i++) {
+      if (definition->components[i].kind == KIND_INPUT) inputs++;
+      if (definition->components[i].kind == KIND_OUTPUT) outputs++;
+    }
+  }
+  return component->numInputs >= inputs && component->numOutputs >= outputs;
+}
+
+usize loadCircuit(Circuit* circuit, char* buffer, usize size, u32 version) {
+  usize pointer = 0;
+  GET(circuit->id);
+  usize used = loadString(&circuit->name, &buffer[pointer], size - pointer);
+  if (!used) return 0;
+  pointer += used;
+  // Every component takes up more than a usize
+  usize numComponents;
+  GET(numComponents);
+  if (!FITS(numComponents, sizeof(usize))) return 0;
+  circuit->components = calloc(numComponents, sizeof(Component));
+  if (numComponents && !circuit->components) return 0;
+  circuit->numComponents = numComponents;
+  for (usize i = 0; i < circuit->numComponents; i++) {
+    used = loadComponent(&circuit->components[i], &buffer[pointer], size - pointer, version);
+    if (!used || circuit->components[i].id != i + 1) return 0;
+    pointer += used;
+  }
+
+  // Connections have to be to outputs that exist
+  for (usize i = 0; i < circuit->numComponents; i++) {
+    Component* component = &circuit->components[i];
+    for (usize j = 0; j < component->numInputs; j++) {
+      Input* input = &component->inputs[j];
+      if (input->component == 0) continue;
+      if (input->component > circuit->numComponents) return 0;
+      if (input->outputIndex >= getComponent(circuit, input->component)->numOutputs) return 0;
+    }
+  }
+
+  for (usize i = 0; i < circuit->numComponents; i++) {
+    Component* component = &circuit->components[i];
+    component->arrival = malloc(sizeof(usize) * component->numOutputs);
+    component->arrivalPin = malloc(sizeof(usize) * component->numOutputs);
+    component->criticalPin = NO_PATH;
+    for (usize j = 0; j < component->numInputs; j++) {
+      if (component->inputs[j].component != 0) {
+        addFanout(getComponent(circuit, component->inputs[j].component), component->id);
+      }
+    }
+  }
+  return pointer;
+}
+
+usize loadCircuits(Project* project, char* buffer, usize size) {
+  usize pointer = 0;
+  u32 magic = 0;
+  u32 version = 0;
+  GET(magic);
+  if (magic == FILE_MAGIC) {
+    GET(version);
+  } else {
+    pointer = 0;
+  }
+  if (version > FILE_VERSION) return 0;
+
+  usize numCircuits;
+  GET(numCircuits);
+  if (numCircuits == 0 || !FITS(numCircuits, sizeof(usize))) return 0;
+  project->circuits = calloc(numCircuits, sizeof(Circuit));
+  if (!project->circuits) return 0;
+  project->numCircuits = numCircuits;
+  for (usize i = 0; i < project->numCircuits; i++) {
+    usize used = loadCircuit(&project->circuits[i], &buffer[pointer], size - pointer, version);
+    if (!used || project->circuits[i].id != i + 1) return 0;
+    pointer += used;
+    rehashCircuit(project, &project->circuits[i]);
+  }
+  return pointer;
+}
+
+#undef GET
+#undef FITS
+
+// An empty project when the file cannot be read or is damaged
+Project loadProject(const char* path) {
+  FILE* file = fopen(path, "rb");
+  if (!file) {
+    printf("Cannot read %s\n", path);
+    return createProject();
+  }
+  fseek(file, 0, SEEK_END);
+  long length = ftell(file);
+  fseek(file, 0, SEEK_SET);
+
+  usize size = length > 0 ? (usize)length : 0;
+  char* buffer = size ? malloc(size) : NULL;
+  bool read = buffer && fread(buffer, size, 1, file) == 1;
+  fclose(file);
+
+  Project project = createProject();
+  bool loaded = read && loadCircuits(&project, buffer, size);
+  free(buffer);
+
+  if (loaded) {
+    indexCircuits(&project);
+    for (usize i = 0; i < project.numCircuits; i++) {
+      for (usize j = 0; j < project.circuits[i].numComponents; j++) {
+        resolveInstance(&project, &project.circuits[i], &project.circuits[i].components[j]);
+      }
+    }
+    for (usize i = 0; i < project.numCircuits && loaded; i++) {
+      for (usize j = 0; j < project.circuits[i].numComponents && loaded; j++) {
+        loaded = hasPins(&project, &project.circuits[i].components[j]);
+      }
+    }
+  }
+  if (!loaded) {
+    printf("%s is damaged\n", path);
+    destroyProject(&project);
+  }
+  return project;
+}
+
+void destroyProject(Project* project) {
+  for (usize i = 0; i < project->numCircuits; i++) {
+    Circuit* circuit = &project->circuits[i];
+    for (usize j = 0; j < circuit->numComponents; j++) {
+      Component* component = &circuit->components[j];
+      releaseMemory(component);
+      destroyString(&component->name);
+      destroyString(&component->image);
+      free(component->inputs);
+      free(component->outputs);
+      free(component->arrival);
+      free(component->arrivalPin);
+      free(component->fanouts);
+      free(component->pins);
+      free(component->nameText);
+    }
+    destroyString(&circuit->name);
+    free(circuit->components);
+    free(circuit->criticalPath);
+    free(circuit->delays);
+    free(circuit->instances);
+    for (usize j = 0; j < circuit->grid.capacity; j++) free(circuit->grid.cells[j].components);
+    free(circuit->grid.cells);
+  }
+  free(project->circuits);
+  free(project->names.slots);
+  *project = createProject();
+}
@@ -0,0 +1,809 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "logicol_core.h"
+
+String createString() {
+  String string;
+  string.length = 0;
+  string.data = NULL;
+  return string;
+}
+
+void destroyString(String* string) {
+  free(string->data);
+}
+
+String fromCString(const char* data) {
+  String string;
+  string.length = strlen(data);
+  string.data = malloc(sizeof(char) * string.length);
+  memcpy(string.data, data, sizeof(char) * string.length);
+  return string;
+}
+
+void appendString(String* base, String* extra) {
+  usize old = base->length;
+  base->length += extra->length;
+  base->data = realloc(base->data, sizeof(char) * base->length);
+  memcpy(&base->data[old], extra->data, sizeof(char) * extra->length);
+}
+
+bool stringEqual(String* a, String* b) {
+  if (a->length != b->length) return false;
+
+  for (usize i = 0; i < a->length; i++) {
+    if (a->data[i] != b->data[i]) return false;
+  }
+
+  return true;
+}
+
+char* toCString(String* string) {
+  char* buffer = malloc(sizeof(char) * (string->length + 1));
+  memset(buffer, 0, sizeof(char) * (string->length + 1));
+  memcpy(buffer, string->data, sizeof(char) * string->length);
+  return buffer;
+}
+
+bool stringEqualCString(String* a, const char* b) {
+  usize length = strlen(b);
+  if (a->length != length) return false;
+  return memcmp(a->data, b, length) == 0;
+}
+
+String cloneString(String* base) {
+  String string;
+  string.length = base->length;
+  string.data = malloc(sizeof(char) * base->length);
+  memcpy(string.data, base->data, sizeof(char) * base->length);
+  return string;
+}
+
+const char* KIND_NAMES[NUM_KINDS] = {
+  NULL, "INPUT", "OUTPUT", "CLOCK", "SPLIT", "MERGE", "NOT", "AND", "OR", "TRISTATE", "BUS",
+  "ADD", "SUB", "CMP", "MUX", "SHL", "SHR", "MUL", "ROM", "RAM", "RAM2",
+};
+
+Kind getKind(String* name) {
+  for (usize i = 1; i < NUM_KINDS; i++) {
+    if (stringEqualCString(name, KIND_NAMES[i])) return i;
+  }
+  return KIND_CIRCUIT;
+}
+
+Project createProject() {
+  Project project;
+  project.numCircuits = 0;
+  project.circuits = NULL;
+  project.names = (CircuitIndex){ 0, NULL };
+  return project;
+}
+
+Circuit* getCircuit(Project* project, CircuitRef ref) {
+  return &project->circuits[ref - 1];
+}
+
+u64 hashBytes(u64 hash, const void* data, usize size) {
+  const u8* bytes = data;
+  for (usize i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+usize getNameSlot(CircuitIndex* index, String* name) {
+  return hashBytes(0xcbf29ce484222325ull, name->data, name->length) & (index->capacity - 1);
+}
+
+void insertName(Project* project, CircuitRef ref) {
+  CircuitIndex* index = &project->names;
+  usize slot = getNameSlot(index, &getCircuit(project, ref)->name);
+  while (index->slots[slot] != 0) slot = (slot + 1) & (index->capacity - 1);
+  index->slots[slot] = ref;
+}
+
+// Builds the index of every circuit again, after loading or when it fills
+// up. Circuits are never renamed or removed, otherwise it only grows.
+void indexCircuits(Project* project) {
+  CircuitIndex* index = &project->names;
+  free(index->slots);
+  index->capacity = 64;
+  while (project->numCircuits * 2 > index->capacity) index->capacity *= 2;
+  index->slots = malloc(sizeof(CircuitRef) * index->capacity);
+  memset(index->slots, 0, sizeof(CircuitRef) * index->capacity);
+  for (usize i = 0; i < project->numCircuits; i++) insertName(project, i + 1);
+}
+
+CircuitRef addCircuit(Project* project, String name) {
+  project->numCircuits++;
+  project->circuits = realloc(project->circuits, project->numCircuits * sizeof *project->circuits);
+	Circuit* circuit = &project->circuits[project->numCircuits - 1];
+  memset(circuit, 0, sizeof *circuit);
+  circuit->id = project->numCircuits;
+  circuit->numComponents = 0;
+  circuit->components = NULL;
+  circuit->name = name;
+  if (project->numCircuits * 2 > project->names.capacity) indexCircuits(project);
+  else insertName(project, circuit->id);
+
+  // Components already named after it become instances of it
+  for (usize i = 0; i < project->numCircuits; i++) project->circuits[i].hashValid = false;
+	return circuit->id;
+}
+
+Circuit* findCircuit(Project* project, String* name) {
+  CircuitIndex* index = &project->names;
+  if (!index->capacity) return NULL;
+  for (usize slot = getNameSlot(index, name); index->slots[slot] != 0; slot = (slot + 1) & (index->capacity - 1)) {
+    Circuit* circuit = getCircuit(project, index->slots[slot]);
+    if (stringEqual(&circuit->name, name)) return circuit;
+  }
+  return NULL;
+}
+
+Component* getComponent(Circuit* circuit, ComponentRef ref) {
+	return &circuit->components[ref - 1];
+}
+
+// Looks up the circuit `component` of `owner` is an instance of and adds it
+// to the instances of that circuit. Loading a project and placing a
+// component both resolve it right away. A circuit takes precedence over a
+// built-in kind of the same name, projects may have circuits named after
+// kinds added since, only the ports are never instances.
+Circuit* resolveInstance(Project* project, Circuit* owner, Component* component) {
+  if (component->definition || component->kind == KIND_INPUT || component->kind == KIND_OUTPUT) return NULL;
+  Circuit* definition = findCircuit(project, &component->name);
+  if (!definition) return NULL;
+  releaseMemory(component);
+  component->kind = KIND_CIRCUIT;
+  if (!owner) return definition;
+  component->definition = definition->id;
+  definition->numInstances++;
+  definition->instances = realloc(definition->instances, sizeof(InstanceRef) * definition->numInstances);
+  definition->instances[definition->numInstances - 1] = (InstanceRef){ owner->id, component->id };
+  invalidateHash(project, owner);
+  return definition;
+}
+
+// The circuit a component is stored in
+Circuit* findOwner(Project* project, Component* component) {
+  for (usize i = 0; i < project->numCircuits; i++) {
+    Circuit* circuit = &project->circuits[i];
+    if (component >= circuit->components && component < circuit->components + circuit->numComponents) return circuit;
+  }
+  return NULL;
+}
+
+// The circuit an instance is of, kept since circuits are never renamed or
+// removed. NULL for primitives and for names no circuit has.
+Circuit* getDefinition(Project* project, Component* component) {
+  if (component->kind != KIND_CIRCUIT) return NULL;
+  if (!component->definition) return resolveInstance(project, findOwner(project, component), component);
+  return getCircuit(project, component->definition);
+}
+
+u64 getWidthMask(usize width) {
+  return width >= 64 ? ~(u64)0 : ((u64)1 << width) - 1;
+}
+
+// The port of a definition backing pin `index` of its instances
+Component* getPort(Circuit* definition, Kind kind, usize index) {
+  for (usize i = 0; i < definition->numComponents; i++) {
+    if (definition->components[i].kind == kind && index-- == 0) {
+      return &definition->components[i];
+    }
+  }
+  return NULL;
+}
+
+// Word-level primitives the simulator evaluates with native integer ops
+bool isWordOp(Component* component) {
+  return component->kind == KIND_ADD || component->kind == KIND_SUB ||
+         component->kind == KIND_CMP || component->kind == KIND_MUX ||
+         component->kind == KIND_SHL || component->kind == KIND_SHR ||
+         component->kind == KIND_MUL;
+}
+
+// ROM reads an address, RAM an address, data and write enable, and RAM2 has
+// two such ports. Their outputs are the data read on each port.
+bool isMemory(Component* component) {
+  return component->kind == KIND_ROM || component->kind == KIND_RAM ||
+         component->kind == KIND_RAM2;
+}
+
+// Words are stored little endian in whole bytes, so images can come from
+// any tool
+usize getWordBytes(usize width) {
+  return (width + 7) / 8;
+}
+
+void releaseMemory(Component* component) {
+  if (!component->memory) return;
+  if (component->kind == KIND_ROM) {
+    munmap(component->memory, component->memorySize);
+  } else {
+    free(component->memory);
+  }
+  component->memory = NULL;
+  component->memorySize = 0;
+}
+
+// Sizes a RAM to its address width, or a ROM's address width to its image
+void updateMemory(Component* component) {
+  usize bytes = getWordBytes(component->width);
+  if (component->kind == KIND_ROM) {
+    usize words = (component->memorySize + bytes - 1) / bytes;
+    component->addressWidth = 1;
+    while (((usize)1 << component->addressWidth) < words && component->addressWidth < MAX_ADDRESS_WIDTH) {
+      component->addressWidth++;
+    }
+    return;
+  }
+
+  usize size = ((usize)1 << component->addressWidth) * bytes;
+  component->memory = realloc(component->memory, size);
+  if (size > component->memorySize) memset(&component->memory[component->memorySize], 0, size - component->memorySize);
+  component->memorySize = size;
+}
+
+// Maps the ROM image read-only, pages are only read in as they are addressed
+void mapImage(Component* component) {
+  releaseMemory(component);
+  char* path = toCString(&component->image);
+  int file = open(path, O_RDONLY);
+  struct stat info;
+  if (file < 0 || fstat(file, &info) != 0 || info.st_size == 0) {
+    printf("Cannot open ROM image %s\n", path);
+    if (file >= 0) close(file);
+    free(path);
+    updateMemory(component);
+    return;
+  }
+
+  void* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+  close(file);
+  if (data == MAP_FAILED) {
+    printf("Cannot map ROM image %s\n", path);
+  } else {
+    component->memory = data;
+    component->memorySize = info.st_size;
+  }
+  free(path);
+  updateMemory(component);
+}
+
+// Pins carry `width` bits, except the single bit side of SPLIT and MERGE, the
+// enable of a TRISTATE, the select of a MUX, the carry of ADD and SUB, the
+// results of CMP, memory addresses and enables, and instance pins, which take
+// the width of their port
+usize getInputWidth(Project* project, Component* component, usize pin) {
+  if (isMemory(component)) {
+    usize role = component->kind == KIND_ROM ? 0 : pin % 3;
+    return role == 0 ? component->addressWidth : role == 1 ? component->width : 1;
+  }
+  if (component->kind == KIND_MERGE) return 1;
+  if (component->kind == KIND_MUX && pin == 2) return 1;
+  if (isWordOp(component)) return component->width;
+  if (component->kind == KIND_TRISTATE && pin == 1) return 1;
+  if (component->kind == KIND_AND || component->kind == KIND_OR ||
+      component->kind == KIND_NOT ||
+      component->kind == KIND_TRISTATE || component->kind == KIND_BUS ||
+      component->kind == KIND_SPLIT || component->kind == KIND_OUTPUT) {
+    return component->width;
+  }
+
+  Circuit* definition = getDefinition(project, component);
+  Component* port = definition ? getPort(definition, KIND_INPUT, pin) : NULL;
+  return port ? port->width : 1;
+}
+
+usize getOutputWidth(Project* project, Component* component, usize pin) {
+  if (component->kind == KIND_SPLIT) return 1;
+  if (component->kind == KIND_CMP) return 1;
+  if ((component->kind == KIND_ADD || component->kind == KIND_SUB) && pin == 1) return 1;
+  if (isWordOp(component) || isMemory(component)) return component->width;
+  if (component->kind == KIND_AND || component->kind == KIND_OR ||
+      component->kind == KIND_NOT ||
+      component->kind == KIND_TRISTATE || component->kind == KIND_BUS ||
+      component->kind == KIND_MERGE || component->kind == KIND_INPUT) {
+    return component->width;
+  }
+
+  Circuit* definition = getDefinition(project, component);
+  Component* port = definition ? getPort(definition, KIND_OUTPUT, pin) : NULL;
+  return port ? port->width : 1;
+}
+
+// Covers what compiles into a netlist, not positions, INPUT values or state
+u64 hashComponent(Component* component) {
+  u64 hash = 0xcbf29ce484222325ull;
+  HASH(component->id);
+  HASH(component->name.length);
+  hash = hashBytes(hash, component->name.data, component->name.length);
+  HASH(component->numInputs);
+  hash = hashBytes(hash, component->inputs, sizeof(Input) * component->numInputs);
+  HASH(component->numOutputs);
+  HASH(component->width);
+  HASH(component->addressWidth);
+  hash = hashBytes(hash, component->image.data, component->image.length);
+  return hash;
+}
+
+// Drops the cached hash of a circuit and of everything that instantiates it,
+// stopping where it was already dropped
+void invalidateHash(Project* project, Circuit* circuit) {
+  if (!circuit->hashValid) return;
+  circuit->hashValid = false;
+  for (usize i = 0; i < circuit->numInstances; i++) {
+    invalidateHash(project, getCircuit(project, circuit->instances[i].circuit));
+  }
+}
+
+void rehashComponent(Project* project, Circuit* circuit, Component* component) {
+  circuit->contentHash ^= component->hash;
+  component->hash = hashComponent(component);
+  circuit->contentHash ^= component->hash;
+  invalidateHash(project, circuit);
+}
+
+void rehashCircuit(Project* project, Circuit* circuit) {
+  invalidateHash(project, circuit);
+  circuit->contentHash = 0;
+  for (usize i = 0; i < circuit->numComponents; i++) {
+    circuit->components[i].hash = hashComponent(&circuit->components[i]);
+    circuit->contentHash ^= circuit->components[i].hash;
+  }
+}
+
+ComponentRef addComponent(Project* project, Circuit* circuit, String name, usize numInputs, usize numOutputs) {
+	Component component;
+	component.pos = (Vector2){ 100, 100 };
+	component.id = circuit->numComponents + 1;
+	component.name = name;
+	component.kind = getKind(&name);
+	component.definition = 0;
+	component.numInputs = numInputs;
+	component.inputs = malloc(sizeof *component.inputs * numInputs);
+	memset(component.inputs, 0, sizeof *component.inputs * numInputs);
+	component.numOutputs = numOutputs;
+	component.outputs = malloc(sizeof(u64) * component.numOutputs);
+	memset(component.outputs, 0, sizeof(u64) * component.numOutputs);
+	component.width = 1;
+	component.ticked = false;
+	component.state = LOGIC_0;
+	component.arrival = malloc(sizeof(usize) * component.numOutputs);
+	memset(component.arrival, 0, sizeof(usize) * component.numOutputs);
+	component.arrivalPin = malloc(sizeof(usize) * component.numOutputs);
+	memset(component.arrivalPin, 0xff, sizeof(usize) * component.numOutputs);
+	component.criticalPin = NO_PATH;
+	component.numFanouts = 0;
+	component.fanouts = NULL;
+	component.timingEpoch = 0;
+	component.timingVisits = 0;
+	component.timingQueued = false;
+	component.addressWidth = 0;
+	component.memory = NULL;
+	component.memorySize = 0;
+	component.image = createString();
+	component.measured = false;
+	component.nameText = NULL;
+	component.pins = NULL;
+	component.filed = false;
+	component.hash = hashComponent(&component);
+
+	circuit->contentHash ^= component.hash;
+  invalidateHash(project, circuit);
+	circuit->numComponents++;
+	circuit->components = realloc(circuit->components, circuit->numComponents * sizeof *circuit->components);
+	circuit->components[circuit->numComponents - 1] = component;
+	return component.id;
+}
+
+// Timing counts NAND levels, the same depth compileComponent produces for each
+// primitive. Subcircuit instances use a pin-to-pin delay table of their
+// definition, so an edit only ever reanalyses the circuit being edited.
+static usize timingEpoch = 0;
+static usize timingClock = 0;
+
+usize getPrimitiveDelay(Component* component) {
+  if (component->kind == KIND_NOT) return 1;
+  if (component->kind == KIND_AND) return 2;
+  if (component->kind == KIND_OR) return 2;
+  if (component->kind == KIND_TRISTATE) return 1;
+  if (component->kind == KIND_BUS) return 1;
+  if (isWordOp(component)) return 1;
+  if (isMemory(component)) return 1;
+  return 0;
+}
+
+bool isPrimitive(Component* component) {
+  return component->kind != KIND_CIRCUIT;
+}
+
+usize getPinArrival(Circuit* circuit, Component* component, usize pin, TimingSources sources) {
+  Input* input = &component->inputs[pin];
+  if (input->component == 0) return sources.internal ? 0 : NO_PATH;
+  return getComponent(circuit, input->component)->arrival[input->outputIndex];
+}
+
+bool evaluateArrival(Project* project, Circuit* circuit, Component* component, TimingSources sources) {
+  bool changed = false;
+
+  if (component->kind == KIND_INPUT) {
+    usize arrival = (sources.allInputs || sources.input == component->id) ? 0 : NO_PATH;
+    changed = component->arrival[0] != arrival;
+    component->arrival[0] = arrival;
+    return changed;
+  }
+
+  // Paths from a CLOCK start at the edge
+  if (component->kind == KIND_CLOCK) {
+    usize arrival = sources.allInputs ? 0 : NO_PATH;
+    changed = component->arrival[0] != arrival;
+    component->arrival[0] = arrival;
+    return changed;
+  }
+
+  usize delay = getPrimitiveDelay(component);
+  Circuit* definition = getDefinition(project, component);
+  if (definition && (!definition->delays || definition->delayInputs != component->numInputs ||
+                     definition->delayOutputs != component->numOutputs)) {
+    definition = NULL;
+  }
+
+  for (usize j = 0; j < component->numOutputs; j++) {
+    usize best = NO_PATH;
+    usize through = NO_PATH;
+
+    if (definition && sources.internal) {
+      best = definition->delays[definition->delayInputs * definition->delayOutputs + j];
+    }
+
+    for (usize i = 0; i < component->numInputs; i++) {
+      usize arrival = getPinArrival(circuit, component, i, sources);
+      usize d = definition ? definition->delays[i * definition->delayOutputs + j] : delay;
+      if (arrival == NO_PATH || d == NO_PATH) continue;
+      if (best == NO_PATH || arrival + d > best) {
+        best = arrival + d;
+        through = i;
+      }
+    }
+
+    if (!definition && component->numInputs == 0 && sources.internal) best = 0;
+
+    if (component->arrival[j] != best || component->arrivalPin[j] != through) changed = true;
+    component->arrival[j] = best;
+    component->arrivalPin[j] = through;
+  }
+
+  return changed;
+}
+
+// Longest paths by queue relaxation. A component is only requeued when one of
+// its drivers changed, and one requeued more often than there are components
+// must sit on a combinational loop.
+void propagateTiming(Project* project, Circuit* circuit, ComponentRef* queue, usize count, TimingSources sources) {
+  usize epoch = ++timingEpoch;
+  usize capacity = circuit->numComponents;
+  usize head = 0;
+
+  for (usize i = 0; i < count; i++) {
+    getComponent(circuit, queue[i])->timingQueued = true;
+  }
+
+  while (count > 0) {
+    Component* component = getComponent(circuit, queue[head]);
+    head = (head + 1) % capacity;
+    count--;
+    component->timingQueued = false;
+
+    if (component->timingEpoch != epoch) {
+      component->timingEpoch = epoch;
+      component->timingVisits = 0;
+    }
+    if (++component->timingVisits > circuit->numComponents) {
+      circuit->timingLoop = true;
+      break;
+    }
+
+    if (!evaluateArrival(project, circuit, component, sources)) continue;
+
+    for (usize i = 0; i < component->numFanouts; i++) {
+      Component* fanout = getComponent(circuit, component->fanouts[i]);
+      if (fanout->timingQueued) continue;
+      fanout->timingQueued = true;
+      queue[(head + count++) % capacity] = fanout->id;
+    }
+  }
+
+  for (usize i = 0; i < circuit->numComponents; i++) {
+    circuit->components[i].timingQueued = false;
+  }
+}
+
+void analyseCircuit(Project* project, Circuit* circuit, TimingSources sources) {
+  if (circuit->numComponents == 0) return;
+
+  ComponentRef* queue = malloc(sizeof(ComponentRef) * circuit->numComponents);
+  for (usize i = 0; i < circuit->numComponents; i++) {
+    Component* component = &circuit->components[i];
+    memset(component->arrival, 0xff, sizeof(usize) * component->numOutputs);
+    queue[i] = component->id;
+  }
+  circuit->timingLoop = false;
+  propagateTiming(project, circuit, queue, circuit->numComponents, sources);
+  free(queue);
+}
+
+void refreshDelays(Project* project, Circuit* circuit, usize epoch);
+
+void refreshInstanceDelays(Project* project, Circuit* circuit, usize epoch, bool* stale) {
+  for (usize i = 0; i < circuit->numComponents; i++) {
+    if (isPrimitive(&circuit->components[i])) continue;
+    Circuit* definition = getDefinition(project, &circuit->components[i]);
+    if (!definition) continue;
+    refreshDelays(project, definition, epoch);
+    if (definition->delaysStamp > circuit->delaysStamp) *stale = true;
+  }
+}
+
+// Recomputes the pin-to-pin delay table of a definition, one analysis per
+// INPUT plus one for paths starting inside it, if it or anything it
+// instantiates changed since the table was built.
+void refreshDelays(Project* project, Circuit* circuit, usize epoch) {
+  if (circuit->delaysBusy || circuit->delaysEpoch == epoch) return;
+  circuit->delaysBusy = true;
+  circuit->delaysEpoch = epoch;
+
+  bool stale = !circuit->delaysValid;
+  refreshInstanceDelays(project, circuit, epoch, &stale);
+  circuit->delaysBusy = false;
+  if (!stale) return;
+
+  usize numInputs = 0;
+  usize numOutputs = 0;
+  for (usize i = 0; i < circuit->numComponents; i++) {
+    if (circuit->components[i].kind == KIND_INPUT) numInputs++;
+    if (circuit->components[i].kind == KIND_OUTPUT) numOutputs++;
+  }
+
+  circuit->delayInputs = numInputs;
+  circuit->delayOutputs = numOutputs;
+  circuit->delays = realloc(circuit->delays, sizeof(usize) * (numInputs + 1) * numOutputs);
+
+  usize row = 0;
+  for (usize i = 0; i <= circuit->numComponents; i++) {
+    TimingSources sources = { false, 0, false };
+    if (i < circuit->numComponents) {
+      if (circuit->components[i].kind != KIND_INPUT) continue;
+      sources.input = circuit->components[i].id;
+    } else {
+      sources.internal = true;
+    }
+
+    analyseCircuit(project, circuit, sources);
+
+    usize column = 0;
+    for (usize j = 0; j < circuit->numComponents; j++) {
+      Component* component = &circuit->components[j];
+      if (component->kind != KIND_OUTPUT) continue;
+      usize arrival = circuit->timingLoop ? NO_PATH : getPinArrival(circuit, component, 0, sources);
+      circuit->delays[row * numOutputs + column++] = arrival;
+    }
+    row++;
+  }
+
+  circuit->delaysValid = true;
+  circuit->delaysStamp = ++timingClock;
+  circuit->timingValid = false;
+}
+
+void traceCriticalPath(Circuit* circuit) {
+  for (usize i = 0; i < circuit->numCriticalPath; i++) {
+    getComponent(circuit, circuit->criticalPath[i])->criticalPin = NO_PATH;
+  }
+  circuit->numCriticalPath = 0;
+  circuit->depth = 0;
+  if (circuit->timingLoop) return;
+
+  Component* end = NULL;
+  TimingSources sources = { true, 0, true };
+  for (usize i = 0; i < circuit->numComponents; i++) {
+    Component* component = &circuit->components[i];
+    if (component->kind != KIND_OUTPUT) continue;
+    usize arrival = getPinArrival(circuit, component, 0, sources);
+    if (!end || arrival > circuit->depth) {
+      end = component;
+      circuit->depth = arrival;
+    }
+  }
+
+  usize pin = 0;
+  while (end && pin != NO_PATH && circuit->numCriticalPath < circuit->numComponents) {
+    end->criticalPin = pin;
+    circuit->criticalPath = realloc(circuit->criticalPath, sizeof(ComponentRef) * (circuit->numCriticalPath + 1));
+    circuit->criticalPath[circuit->numCriticalPath++] = end->id;
+
+    Input* input = &end->inputs[pin];
+    if (input->component == 0) break;
+    end = getComponent(circuit, input->component);
+    pin = end->arrivalPin[input->outputIndex];
+  }
+}
+
+// Full analysis of the circuit being edited, only run when it was invalidated
+void refreshTiming(Project* project, Circuit* circuit) {
+  if (circuit->timingValid) return;
+
+  bool stale = false;
+  refreshInstanceDelays(project, circuit, ++timingClock, &stale);
+  analyseCircuit(project, circuit, (TimingSources){ true, 0, true });
+  traceCriticalPath(circuit);
+  circuit->timingValid = true;
+}
+
+// Incremental analysis after `changed` got new inputs, repropagating only
+// through the components downstream of it
+void updateTiming(Project* project, Circuit* circuit, ComponentRef changed) {
+  circuit->delaysValid = false;
+  if (!circuit->timingValid || circuit->timingLoop) {
+    circuit->timingValid = false;
+    return;
+  }
+
+  Component* component = getComponent(circuit, changed);
+  if (!isPrimitive(component)) {
+    Circuit* definition = getDefinition(project, component);
+    if (definition && definition != circuit) refreshDelays(project, definition, ++timingClock);
+    if (!circuit->timingValid) return;
+  }
+
+  ComponentRef* queue = malloc(sizeof(ComponentRef) * circuit->numComponents);
+  queue[0] = changed;
+  propagateTiming(project, circuit, queue, 1, (TimingSources){ true, 0, true });
+  free(queue);
+  traceCriticalPath(circuit);
+}
+
+void addFanout(Component* component, ComponentRef to) {
+  component->numFanouts++;
+  component->fanouts = realloc(component->fanouts, sizeof(ComponentRef) * component->numFanouts);
+  component->fanouts[component->numFanouts - 1] = to;
+}
+
+void removeFanout(Component* component, ComponentRef to) {
+  for (usize i = 0; i < component->numFanouts; i++) {
+    if (component->fanouts[i] == to) {
+      component->fanouts[i] = component->fanouts[--component->numFanouts];
+      return;
+    }
+  }
+}
+
+void addConnection(Project* project, Circuit* circuit, ComponentRef from, ComponentRef to, usize fromIndex, usize toIndex) {
+	Component* t = getComponent(circuit, to);	
+	Component* f = getComponent(circuit, from);
+
+  bool deleting = t->inputs[toIndex].component == from && t->inputs[toIndex].outputIndex == fromIndex;
+  if (!deleting && getOutputWidth(project, f, fromIndex) != getInputWidth(project, t, toIndex)) {
+    printf("Cannot connect a %zu bit output to a %zu bit input\n", getOutputWidth(project, f, fromIndex), getInputWidth(project, t, toIndex));
+    return;
+  }
+
+  if (t->inputs[toIndex].component != 0) {
+    removeFanout(getComponent(circuit, t->inputs[toIndex].component), to);
+  }
+
+  if (deleting) { // Delete connection
+    t->inputs[toIndex].component = 0;
+	  t->inputs[toIndex].outputIndex = 0;
+    rehashComponent(project, circuit, t);
+    updateTiming(project, circuit, to);
+    return;
+  }
+
+	t->inputs[toIndex].component = from;
+	t->inputs[toIndex].outputIndex = fromIndex;
+  addFanout(f, to);
+
+  if (t->kind == KIND_BUS && toIndex == t->numInputs - 1) { // Always keep a free driver pin
+    t->numInputs++;
+    t->inputs = realloc(t->inputs, sizeof(Input) * t->numInputs);
+    memset(&t->inputs[t->numInputs - 1], 0, sizeof(Input));
+  }
+  rehashComponent(project, circuit, t);
+  updateTiming(project, circuit, to);
+}
+
+// SPLIT and MERGE have one pin per bit on their narrow side, connections to
+// pins that go away are dropped
+void setWidth(Project* project, Circuit* circuit, Component* component, usize width) {
+  if (width < 1 || width > MAX_WIDTH) return;
+  component->width = width;
+  if (component->numOutputs) component->outputs[0] &= getWidthMask(width);
+
+  if (component->kind == KIND_SPLIT) {
+    for (usize i = 0; i < circuit->numComponents; i++) {
+      Component* other = &circuit->components[i];
+      for (usize j = 0; j < other->numInputs; j++) {
+        if (other->inputs[j].component == component->id && other->inputs[j].outputIndex >= width) {
+          removeFanout(component, other->id);
+          memset(&other->inputs[j], 0, sizeof(Input));
+        }
+      }
+    }
+    component->numOutputs = width;
+    component->outputs = realloc(component->outputs, sizeof(u64) * width);
+    memset(component->outputs, 0, sizeof(u64) * width);
+    component->arrival = realloc(component->arrival, sizeof(usize) * width);
+    component->arrivalPin = realloc(component->arrivalPin, sizeof(usize) * width);
+  }
+
+  if (component->kind == KIND_MERGE) {
+    for (usize i = width; i < component->numInputs; i++) {
+      if (component->inputs[i].component != 0) {
+        removeFanout(getComponent(circuit, component->inputs[i].component), component->id);
+      }
+    }
+    usize old = component->numInputs;
+    component->numInputs = width;
+    component->inputs = realloc(component->inputs, sizeof(Input) * width);
+    if (width > old) memset(&component->inputs[old], 0, sizeof(Input) * (width - old));
+  }
+
+  if (isMemory(component)) updateMemory(component);
+  circuit->timingValid = false;
+  rehashCircuit(project, circuit); // Connections to SPLIT and MERGE may have gone
+}
+
+void setAddressWidth(Project* project, Circuit* circuit, Component* component, usize addressWidth) {
+  if (!isMemory(component) || component->kind == KIND_ROM) return;
+  if (addressWidth < 1 || addressWidth > MAX_ADDRESS_WIDTH) return;
+  component->addressWidth = addressWidth;
+  updateMemory(component);
+  circuit->timingValid = false;
+  rehashComponent(project, circuit, component);
+}
+
+void updateInputs(Project* project, Circuit* active) {
+  usize numInputs = 0;
+  for (usize i = 0; i < active->numComponents; i++) {
+    if (active->components[i].kind == KIND_INPUT) {
+      numInputs++;
+    }
+  }
+
+  for (usize i = 0; i < active->numInstances; i++) {
+    Circuit* circuit = getCircuit(project, active->instances[i].circuit);
+    Component* instance = getComponent(circuit, active->instances[i].component);
+    instance->numInputs = numInputs;
+    instance->inputs = realloc(instance->inputs, sizeof(Input) * numInputs);
+    memset(&instance->inputs[numInputs - 1], 0, sizeof(Input));
+    circuit->timingValid = false;
+    rehashComponent(project, circuit, instance);
+  }
+}
+
+void updateOutputs(Project* project, Circuit* active) {
+  usize numOutputs = 0;
+  for (usize i = 0; i < active->numComponents; i++) {
+    if (active->components[i].kind == KIND_OUTPUT) {
+      numOutputs++;
+    }
+  }
+
+  for (usize i = 0; i < active->numInstances; i++) {
+    Circuit* circuit = getCircuit(project, active->instances[i].circuit);
+    Component* instance = getComponent(circuit, active->instances[i].component);
+    instance->numOutputs = numOutputs;
+    instance->outputs = realloc(instance->outputs, sizeof(u64) * numOutputs);
+    instance->outputs[numOutputs - 1] = 0;
+    instance->arrival = realloc(instance->arrival, sizeof(usize) * numOutputs);
+    instance->arrivalPin = realloc(instance->arrivalPin, sizeof(usize) * numOutputs);
+    circuit->timingValid = false;
+    rehashComponent(project, circuit, instance);
+  }
+}
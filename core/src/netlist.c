@@ -0,0 +1,823 @@
+#include <sys/mman.h>
+#include "logicol_core.h"
+
+typedef struct {
+  usize count;
+  usize capacity;
+  Node** nodes;
+} NodeList;
+
+void collectNodes(Node* node, NodeList* list) {
+  if (node->net) return;
+  if (node->left) collectNodes(node->left, list);
+  if (node->right) collectNodes(node->right, list);
+  for (usize i = 0; i < node->numOperands; i++) {
+    collectNodes(node->operands[i], list);
+  }
+
+  if (list->count == list->capacity) {
+    list->capacity = list->capacity ? list->capacity * 2 : 64;
+    list->nodes = realloc(list->nodes, sizeof(Node*) * list->capacity);
+  }
+  list->nodes[list->count++] = node;
+  node->net = list->count;
+}
+
+Node* resolveAlias(Node* node) {
+  while (node->type == ALIAS) node = node->left;
+  return node;
+}
+
+bool mayFloat(Node* node) {
+  return node->type == FLOATING || node->type == TRISTATE || node->type == RESOLVE || node->type == PORT;
+}
+
+Netlist flattenTree(Tree tree) {
+  NodeList list = { 0 };
+  for (usize i = 0; i < tree.numRoots; i++) {
+    collectNodes(&tree.roots[i], &list);
+  }
+  for (usize i = 0; i < tree.numMemories; i++) {
+    collectNodes(tree.memories[i], &list);
+  }
+
+  usize capacity = list.count * 2;
+  u8* types = malloc(capacity);
+  u32* left = malloc(sizeof(u32) * capacity);
+  u32* right = malloc(sizeof(u32) * capacity);
+  usize* level = malloc(sizeof(usize) * capacity);
+  u32* index = malloc(sizeof(u32) * list.count);
+  u32* receiver = malloc(sizeof(u32) * list.count);
+  memset(receiver, 0xff, sizeof(u32) * list.count);
+  usize count = 0;
+  usize numLevels = 1;
+  usize numWords = 0;
+  Word* words = NULL;
+  Memo copies = { 0 };
+
+  for (usize i = 0; i < list.count; i++) {
+    Node* node = list.nodes[i];
+    if (node->type == ALIAS) {
+      index[i] = index[resolveAlias(node)->net - 1];
+      continue;
+    }
+
+    if (node->type == WORD) {
+      words = realloc(words, sizeof(Word) * (numWords + 1));
+      Word* word = &words[numWords];
+      word->op = node->op;
+      word->width = node->width;
+      word->numOperands = node->numOperands;
+      word->operands = malloc(sizeof(u32) * node->numOperands);
+      word->numResults = getValueWidth(node->op, node->width) + getNumFlags(node->op);
+      word->results = malloc(sizeof(u32) * word->numResults);
+      memset(word->results, 0xff, sizeof(u32) * word->numResults);
+      word->addressWidth = 0;
+      word->memory = NULL;
+      word->memorySize = 0;
+      word->ownsMemory = false;
+      word->module = node->module;
+      word->instance = NULL;
+      word->batch = 0;
+      word->circuit = node->circuit ? node->circuit->id : 0;
+      word->component = node->component ? node->component->id : 0;
+      word->path = node->path;
+      if (node->op >= WORD_ROM && node->op != WORD_CALL) {
+        Component* component = node->component;
+        word->addressWidth = component->addressWidth;
+        word->memory = component->memory;
+        word->memorySize = component->memorySize;
+        if (node->path != 0 && node->op != WORD_ROM) {
+          void** copy = findMemo(&copies, node->path, (usize)component, 0, 0);
+          if (!*copy) {
+            *copy = malloc(component->memorySize);
+            memcpy(*copy, component->memory, component->memorySize);
+            word->ownsMemory = true;
+          }
+          word->memory = *copy;
+        }
+      }
+
+      usize operandLevel = 0;
+      for (usize j = 0; j < node->numOperands; j++) {
+        word->operands[j] = index[resolveAlias(node->operands[j])->net - 1];
+        if (level[word->operands[j]] > operandLevel) operandLevel = level[word->operands[j]];
+      }
+
+      types[count] = WORD;
+      left[count] = numWords++;
+      right[count] = 0;
+      level[count] = operandLevel + 1;
+      if (level[count] + 1 > numLevels) numLevels = level[count] + 1;
+      index[i] = count++;
+      continue;
+    }
+
+    if (node->type == SLICE) {
+      u32 word = index[resolveAlias(node->left)->net - 1];
+      words[left[word]].results[node->bit] = count;
+      types[count] = SLICE;
+      left[count] = word;
+      right[count] = word;
+      level[count] = level[word] + 1;
+      if (level[count] + 1 > numLevels) numLevels = level[count] + 1;
+      index[i] = count++;
+      continue;
+    }
+
+    u32 operands[2] = { 0, 0 };
+    usize operandLevel = 0;
+    Node* children[2] = { node->left, node->right };
+
+    for (usize j = 0; j < 2; j++) {
+      if (!children[j]) continue;
+      children[j] = resolveAlias(children[j]);
+      usize child = children[j]->net - 1;
+      operands[j] = index[child];
+      if (node->type != RESOLVE && mayFloat(children[j])) {
+        if (receiver[child] == (u32)-1) {
+          types[count] = FLOAT_TO_X;
+          left[count] = index[child];
+          right[count] = index[child];
+          level[count] = level[index[child]] + 1;
+          receiver[child] = count++;
+        }
+        operands[j] = receiver[child];
+      }
+      if (level[operands[j]] > operandLevel) operandLevel = level[operands[j]];
+    }
+
+    types[count] = node->type;
+    left[count] = operands[0];
+    right[count] = operands[1];
+    level[count] = node->left ? operandLevel + 1 : 0;
+    if (level[count] + 1 > numLevels) numLevels = level[count] + 1;
+    index[i] = count++;
+  }
+
+  Netlist netlist;
+  netlist.numNodes = count;
+  netlist.numLevels = numLevels;
+  netlist.levels = malloc(sizeof(usize) * (numLevels + 1));
+  memset(netlist.levels, 0, sizeof(usize) * (numLevels + 1));
+  for (usize i = 0; i < count; i++) {
+    netlist.levels[level[i] + 1]++;
+  }
+  for (usize i = 0; i < numLevels; i++) {
+    netlist.levels[i + 1] += netlist.levels[i];
+  }
+
+  u32* position = malloc(sizeof(u32) * count);
+  usize* next = malloc(sizeof(usize) * numLevels);
+  memcpy(next, netlist.levels, sizeof(usize) * numLevels);
+  for (usize i = 0; i < count; i++) {
+    position[i] = next[level[i]]++;
+  }
+
+  netlist.types = malloc(count);
+  netlist.left = malloc(sizeof(u32) * count);
+  netlist.right = malloc(sizeof(u32) * count);
+  netlist.one = malloc(sizeof(u64) * count);
+  netlist.zero = malloc(sizeof(u64) * count);
+  memset(netlist.one, 0, sizeof(u64) * count);
+  memset(netlist.zero, 0, sizeof(u64) * count);
+  for (usize i = 0; i < count; i++) {
+    u32 at = position[i];
+    netlist.types[at] = types[i];
+    netlist.left[at] = types[i] == WORD ? left[i] : position[left[i]];
+    netlist.right[at] = position[right[i]];
+  }
+
+  for (usize i = 0; i < numWords; i++) {
+    for (usize j = 0; j < words[i].numOperands; j++) {
+      words[i].operands[j] = position[words[i].operands[j]];
+    }
+    for (usize j = 0; j < words[i].numResults; j++) {
+      if (words[i].results[j] != (u32)-1) words[i].results[j] = position[words[i].results[j]];
+    }
+  }
+  netlist.numWords = numWords;
+  netlist.words = words;
+  netlist.numLanes = 64;
+
+  usize* offsets = malloc(sizeof(usize) * (tree.circuit->numComponents + 1));
+  netlist.numPorts = 0;
+  for (usize i = 0; i < tree.circuit->numComponents; i++) {
+    offsets[i] = netlist.numPorts;
+    if (tree.circuit->components[i].kind == KIND_INPUT) netlist.numPorts += tree.circuit->components[i].width;
+  }
+  netlist.ports = malloc(sizeof(u32) * netlist.numPorts);
+  memset(netlist.ports, 0xff, sizeof(u32) * netlist.numPorts);
+  for (usize i = 0; i < list.count; i++) {
+    Node* node = list.nodes[i];
+    if (node->type != INPUT && node->type != PORT) continue;
+    netlist.ports[offsets[node->component - tree.circuit->components] + node->bit] = position[index[i]];
+  }
+  free(offsets);
+
+  netlist.numClocks = 0;
+  netlist.clocks = NULL;
+  for (usize i = 0; i < list.count; i++) {
+    if (list.nodes[i]->type != CLOCK) continue;
+    netlist.numClocks++;
+    netlist.clocks = realloc(netlist.clocks, sizeof(u32) * netlist.numClocks);
+    netlist.clocks[netlist.numClocks - 1] = position[index[i]];
+  }
+
+  for (usize i = 0; i < list.count; i++) {
+    if (list.nodes[i]->type != INPUT && list.nodes[i]->type != CONSTANT && list.nodes[i]->type != CLOCK) continue;
+    u32 at = position[index[i]];
+    netlist.one[at] = list.nodes[i]->output ? ~(u64)0 : 0;
+    netlist.zero[at] = ~netlist.one[at];
+  }
+
+  netlist.needsFourState = false;
+  netlist.numResolvers = 0;
+  netlist.resolvers = NULL;
+  netlist.resolverComponents = NULL;
+  netlist.resolverCircuits = NULL;
+  for (usize i = 0; i < list.count; i++) {
+    Node* node = list.nodes[i];
+    if (node->type == TRISTATE) netlist.needsFourState = true;
+    if (node->type == WORD && node->op == WORD_CALL && node->module->needsFourState) netlist.needsFourState = true;
+    if (node->type != RESOLVE) continue;
+    netlist.needsFourState = true;
+    netlist.numResolvers++;
+    netlist.resolvers = realloc(netlist.resolvers, sizeof(u32) * netlist.numResolvers);
+    netlist.resolverComponents = realloc(netlist.resolverComponents, sizeof(ComponentRef) * netlist.numResolvers);
+    netlist.resolverCircuits = realloc(netlist.resolverCircuits, sizeof(CircuitRef) * netlist.numResolvers);
+    netlist.resolvers[netlist.numResolvers - 1] = position[index[i]];
+    netlist.resolverComponents[netlist.numResolvers - 1] = node->component->id;
+    netlist.resolverCircuits[netlist.numResolvers - 1] = node->circuit->id;
+  }
+
+  netlist.numRoots = tree.numRoots;
+  netlist.roots = malloc(sizeof(u32) * tree.numRoots);
+  for (usize i = 0; i < tree.numRoots; i++) {
+    netlist.roots[i] = position[index[tree.roots[i].net - 1]];
+  }
+  netlist.numProbes = tree.numProbes;
+  netlist.probes = tree.probes;
+  netlist.numPaths = tree.numPaths;
+  netlist.paths = tree.paths;
+  for (usize i = 0; i < tree.numProbes; i++) {
+    Node* node = tree.probeNodes[i];
+    if (node->net != 0) netlist.probes[i].net = position[index[node->net - 1]];
+  }
+
+  netlist.hasStores = false;
+  for (usize i = 0; i < numWords; i++) {
+    if (words[i].op == WORD_STORE || (words[i].op == WORD_CALL && words[i].module->hasStores)) netlist.hasStores = true;
+  }
+  netlist.shared = false;
+  netlist.modules = tree.modules;
+  netlist.definition = tree.circuit->id;
+  netlist.hash = 0;
+  netlist.mapping = NULL;
+  netlist.mappingSize = 0;
+  netlist.numBatches = 0;
+  netlist.batches = NULL;
+  if (tree.modules) instantiateWords(&netlist);
+
+  for (usize i = 0; i < list.count; i++) {
+    Node* node = list.nodes[i];
+    free(node->operands);
+    if (node < tree.roots || node >= tree.roots + tree.numRoots) free(node);
+  }
+  free(tree.roots);
+  free(list.nodes);
+  free(types);
+  free(left);
+  free(right);
+  free(level);
+  free(index);
+  free(receiver);
+  free(position);
+  free(next);
+  free(tree.memories);
+  free(tree.probeNodes);
+  destroyMemo(&copies);
+
+  return netlist;
+}
+
+void destroyNetlist(Netlist* netlist) {
+  for (usize i = 0; i < netlist->numWords; i++) {
+    Word* word = &netlist->words[i];
+    if (word->ownsMemory) free(word->memory);
+    if (word->instance) {
+      destroyNetlist(word->instance);
+      free(word->instance);
+    }
+    if (netlist->shared || netlist->mapping) continue;
+    free(word->operands);
+    free(word->results);
+  }
+  free(netlist->words);
+  free(netlist->one);
+  free(netlist->zero);
+  for (usize i = 0; i < netlist->numBatches; i++) {
+    destroyNetlist(netlist->batches[i].state);
+    free(netlist->batches[i].state);
+    free(netlist->batches[i].calls);
+  }
+  free(netlist->batches);
+
+  if (netlist->mapping) {
+    munmap(netlist->mapping, netlist->mappingSize);
+  } else if (!netlist->shared) {
+    free(netlist->types);
+    free(netlist->left);
+    free(netlist->right);
+    free(netlist->levels);
+    free(netlist->roots);
+    free(netlist->resolvers);
+    free(netlist->resolverComponents);
+    free(netlist->resolverCircuits);
+    free(netlist->ports);
+    free(netlist->clocks);
+    free(netlist->probes);
+    free(netlist->paths);
+  }
+
+  for (usize i = 0; netlist->modules && i < netlist->modules->capacity; i++) {
+    Netlist* module = netlist->modules->entries[i].value;
+    if (!module) continue;
+    destroyNetlist(module);
+    free(module);
+  }
+  if (netlist->modules) {
+    destroyMemo(netlist->modules);
+    free(netlist->modules);
+  }
+}
+
+Netlist* createInstance(Netlist* module) {
+  Netlist* instance = malloc(sizeof(Netlist));
+  *instance = *module;
+  instance->shared = true;
+  instance->modules = NULL;
+  instance->mapping = NULL;
+  instance->one = malloc(sizeof(u64) * module->numNodes);
+  instance->zero = malloc(sizeof(u64) * module->numNodes);
+  memcpy(instance->one, module->one, sizeof(u64) * module->numNodes);
+  memcpy(instance->zero, module->zero, sizeof(u64) * module->numNodes);
+  instance->words = malloc(sizeof(Word) * module->numWords);
+  if (module->numWords) memcpy(instance->words, module->words, sizeof(Word) * module->numWords);
+  instantiateWords(instance);
+  return instance;
+}
+
+// Gives every CALL its own instance, and every RAM of an instance its own
+// copy of the definition's contents
+void instantiateWords(Netlist* netlist) {
+  for (usize i = 0; i < netlist->numWords; i++) {
+    Word* word = &netlist->words[i];
+    if (word->op == WORD_CALL) word->instance = createInstance(word->module);
+    if (netlist->shared) word->ownsMemory = false;
+  }
+  if (netlist->shared) copyMemories(netlist);
+}
+
+// Gives the RAMs a netlist shares with their components a copy of their own,
+// a read and the store of one RAM keep sharing it
+void copyMemories(Netlist* netlist) {
+  Memo copies = { 0 };
+  for (usize i = 0; i < netlist->numWords; i++) {
+    Word* word = &netlist->words[i];
+    if (word->ownsMemory) *findMemo(&copies, 0, (usize)word->memory, 0, 0) = word->memory;
+  }
+  for (usize i = 0; i < netlist->numWords; i++) {
+    Word* word = &netlist->words[i];
+    if (!word->memory || word->ownsMemory) continue;
+    if (word->op != WORD_RAM && word->op != WORD_RAM2 && word->op != WORD_STORE) continue;
+
+    void** copy = findMemo(&copies, 0, (usize)word->memory, 0, 0);
+    if (!*copy) {
+      *copy = malloc(word->memorySize);
+      memcpy(*copy, word->memory, word->memorySize);
+      word->ownsMemory = true;
+    }
+    word->memory = *copy;
+  }
+  destroyMemo(&copies);
+}
+
+// When a netlist only uses lane 0, calls of the same module on the same level
+// do not depend on each other and can share one state, instance k in lane k.
+// Modules with RAMs keep their own instances, their arrays are per instance.
+void batchInstances(Netlist* netlist) {
+  if (netlist->numLanes != 1) return;
+
+  for (usize level = 1; level < netlist->numLevels; level++) {
+    usize end = netlist->levels[level + 1];
+    for (usize i = netlist->levels[level]; i < end; i++) {
+      if (netlist->types[i] != WORD) continue;
+      Word* word = &netlist->words[netlist->left[i]];
+      if (word->op != WORD_CALL || word->batch || word->module->hasStores) continue;
+
+      Batch batch;
+      batch.module = word->module;
+      batch.numCalls = 0;
+      batch.calls = malloc(sizeof(u32) * 64);
+      for (usize j = i; j < end && batch.numCalls < 64; j++) {
+        if (netlist->types[j] != WORD) continue;
+        Word* other = &netlist->words[netlist->left[j]];
+        if (other->op != WORD_CALL || other->batch || other->module != word->module) continue;
+        batch.calls[batch.numCalls++] = netlist->left[j];
+      }
+      if (batch.numCalls < 2) {
+        free(batch.calls);
+        continue;
+      }
+
+      batch.state = createInstance(batch.module);
+      netlist->numBatches++;
+      netlist->batches = realloc(netlist->batches, sizeof(Batch) * netlist->numBatches);
+      netlist->batches[netlist->numBatches - 1] = batch;
+      for (usize k = 0; k < batch.numCalls; k++) {
+        Word* call = &netlist->words[batch.calls[k]];
+        call->batch = netlist->numBatches;
+        destroyNetlist(call->instance);
+        free(call->instance);
+        call->instance = NULL;
+      }
+    }
+  }
+
+  for (usize i = 0; i < netlist->numWords; i++) {
+    Netlist* instance = netlist->words[i].instance;
+    if (!instance) continue;
+    instance->numLanes = 1;
+    batchInstances(instance);
+  }
+}
+
+// Transposes a 64x64 bit matrix in place, so bit b of row l moves to bit l of
+// row b. Used to turn bit-sliced nets into one integer per lane and back.
+void transpose64(u64* rows) {
+  u64 mask = 0x00000000ffffffffull;
+  for (usize j = 32; j != 0; j >>= 1, mask ^= mask << j) {
+    for (usize k = 0; k < 64; k = (k + j + 1) & ~j) {
+      u64 t = ((rows[k] >> j) ^ rows[k + j]) & mask;
+      rows[k] ^= t << j;
+      rows[k + j] ^= t;
+    }
+  }
+}
+
+void gatherLanes(Netlist* netlist, u32* nets, usize count, u64* lanes) {
+  if (netlist->numLanes > 8) {
+    for (usize b = 0; b < 64; b++) {
+      lanes[b] = b < count ? netlist->one[nets[b]] : 0;
+    }
+    transpose64(lanes);
+    return;
+  }
+
+  for (usize lane = 0; lane < netlist->numLanes; lane++) {
+    u64 value = 0;
+    for (usize b = 0; b < count; b++) {
+      value |= ((netlist->one[nets[b]] >> lane) & 1) << b;
+    }
+    lanes[lane] = value;
+  }
+}
+
+void scatterLanes(Netlist* netlist, u64* lanes, u32* nets, usize count, u64 unknown, bool fourState) {
+  if (netlist->numLanes > 8) transpose64(lanes);
+
+  for (usize b = 0; b < count; b++) {
+    if (nets[b] == (u32)-1) continue;
+    u64 bits = 0;
+    if (netlist->numLanes > 8) {
+      bits = lanes[b];
+    } else {
+      for (usize lane = 0; lane < netlist->numLanes; lane++) {
+        bits |= ((lanes[lane] >> b) & 1) << lane;
+      }
+    }
+    netlist->one[nets[b]] = bits | unknown;
+    if (fourState) netlist->zero[nets[b]] = ~bits | unknown;
+  }
+}
+
+u64 getUnknownLanes(Netlist* netlist, Word* word, bool fourState) {
+  u64 unknown = 0;
+  for (usize i = 0; i < word->numOperands && fourState; i++) {
+    u32 net = word->operands[i];
+    unknown |= (netlist->one[net] & netlist->zero[net]) | ~(netlist->one[net] | netlist->zero[net]);
+  }
+  return unknown;
+}
+
+// Addresses past the end of a ROM image read as zero
+u64 readMemory(Word* word, u64 address) {
+  usize bytes = getWordBytes(word->width);
+  u64 value = 0;
+  for (usize k = 0; k < bytes; k++) {
+    usize at = address * bytes + k;
+    if (at < word->memorySize) value |= (u64)word->memory[at] << (8 * k);
+  }
+  return value & getWidthMask(word->width);
+}
+
+void evaluateMemory(Netlist* netlist, Word* word, bool fourState) {
+  u64 address[64];
+  u64 value[64];
+  usize lanes = netlist->numLanes > 8 ? 64 : netlist->numLanes;
+  u64 unknown = getUnknownLanes(netlist, word, fourState);
+  usize ports = word->op == WORD_RAM2 ? 2 : 1;
+
+  for (usize port = 0; port < ports; port++) {
+    gatherLanes(netlist, word->operands + port * word->addressWidth, word->addressWidth, address);
+    for (usize lane = 0; lane < 64; lane++) {
+      value[lane] = lane < lanes ? readMemory(word, address[lane]) : 0;
+    }
+    scatterLanes(netlist, value, word->results + port * word->width, word->width, unknown, fourState);
+  }
+}
+
+// Commits the writes of a RAM after the tick, port A before port B and lane
+// by lane, as all lanes share the one array. Unknown lanes do not write.
+void storeMemory(Netlist* netlist, Word* word, bool fourState) {
+  u64 address[64];
+  u64 data[64];
+  u64 enable[64];
+  usize lanes = netlist->numLanes > 8 ? 64 : netlist->numLanes;
+  u64 unknown = getUnknownLanes(netlist, word, fourState);
+  usize bytes = getWordBytes(word->width);
+  usize stride = word->addressWidth + word->width + 1;
+
+  for (usize port = 0; port < word->numOperands / stride; port++) {
+    u32* operands = word->operands + port * stride;
+    gatherLanes(netlist, operands, word->addressWidth, address);
+    gatherLanes(netlist, operands + word->addressWidth, word->width, data);
+    gatherLanes(netlist, operands + word->addressWidth + word->width, 1, enable);
+    for (usize lane = 0; lane < lanes; lane++) {
+      if (!(enable[lane] & 1) || ((unknown >> lane) & 1)) continue;
+      for (usize k = 0; k < bytes; k++) {
+        usize at = address[lane] * bytes + k;
+        if (at < word->memorySize) word->memory[at] = data[lane] >> (8 * k);
+      }
+    }
+  }
+}
+
+void storeMemories(Netlist* netlist, bool fourState) {
+  for (usize i = 0; i < netlist->numWords; i++) {
+    if (netlist->words[i].op == WORD_STORE) storeMemory(netlist, &netlist->words[i], fourState);
+  }
+}
+
+// Copies the operands into the PORTs of the instance, ticks it and copies its
+// OUTPUT bits back. Lanes line up, so whole words move.
+void evaluateCall(Netlist* netlist, Word* word, bool fourState) {
+  Netlist* instance = word->instance;
+  for (usize i = 0; i < word->numOperands && i < instance->numPorts; i++) {
+    u32 port = instance->ports[i];
+    if (port == (u32)-1) continue;
+    instance->one[port] = netlist->one[word->operands[i]];
+    instance->zero[port] = netlist->zero[word->operands[i]];
+  }
+
+  instance->numLanes = netlist->numLanes;
+  if (fourState) {
+    tickNetlist4(instance);
+  } else {
+    tickNetlist(instance);
+  }
+
+  for (usize i = 0; i < word->numResults && i < instance->numRoots; i++) {
+    if (word->results[i] == (u32)-1) continue;
+    netlist->one[word->results[i]] = instance->one[instance->roots[i]];
+    netlist->zero[word->results[i]] = instance->zero[instance->roots[i]];
+  }
+}
+
+// Transposes lane 0 of every call's operands into the lanes of the shared
+// state, ticks it once and hands each call its lane of the results
+void evaluateBatch(Netlist* netlist, Batch* batch, bool fourState) {
+  Netlist* state = batch->state;
+  for (usize i = 0; i < state->numPorts; i++) {
+    u32 port = state->ports[i];
+    if (port == (u32)-1) continue;
+    u64 one = 0;
+    u64 zero = 0;
+    for (usize k = 0; k < batch->numCalls; k++) {
+      Word* call = &netlist->words[batch->calls[k]];
+      if (i >= call->numOperands) continue;
+      one |= (netlist->one[call->operands[i]] & 1) << k;
+      zero |= (netlist->zero[call->operands[i]] & 1) << k;
+    }
+    state->one[port] = one;
+    state->zero[port] = zero;
+  }
+
+  state->numLanes = batch->numCalls;
+  if (fourState) {
+    tickNetlist4(state);
+  } else {
+    tickNetlist(state);
+  }
+
+  for (usize k = 0; k < batch->numCalls; k++) {
+    Word* call = &netlist->words[batch->calls[k]];
+    for (usize i = 0; i < call->numResults && i < state->numRoots; i++) {
+      if (call->results[i] == (u32)-1) continue;
+      netlist->one[call->results[i]] = (state->one[state->roots[i]] >> k) & 1;
+      netlist->zero[call->results[i]] = (state->zero[state->roots[i]] >> k) & 1;
+    }
+  }
+}
+
+// Word ops run natively on one integer per lane. In four-state mode a lane
+// with any unknown operand bit gets every result bit X.
+void evaluateWord(Netlist* netlist, Word* word, bool fourState) {
+  if (word->op == WORD_STORE) return;
+  if (word->op == WORD_CALL && word->batch) {
+    Batch* batch = &netlist->batches[word->batch - 1];
+    if (&netlist->words[batch->calls[0]] == word) evaluateBatch(netlist, batch, fourState);
+    return;
+  }
+  if (word->op == WORD_CALL) {
+    evaluateCall(netlist, word, fourState);
+    return;
+  }
+  if (word->op >= WORD_ROM) {
+    evaluateMemory(netlist, word, fourState);
+    return;
+  }
+
+  u64 a[64];
+  u64 b[64];
+  u64 select[64];
+  u64 value[64];
+  u64 flags[64];
+  usize width = word->width;
+  usize lanes = netlist->numLanes > 8 ? 64 : netlist->numLanes;
+
+  gatherLanes(netlist, word->operands, width, a);
+  gatherLanes(netlist, word->operands + width, width, b);
+  if (word->op == WORD_MUX) gatherLanes(netlist, word->operands + 2 * width, 1, select);
+
+  u64 mask = getWidthMask(width);
+  for (usize lane = 0; lane < lanes; lane++) {
+    u64 x = a[lane];
+    u64 y = b[lane];
+    u64 v = 0;
+    u64 f = 0;
+    switch (word->op) {
+      case WORD_ADD: v = x + y; f = width < 64 ? (v >> width) & 1 : v < x; break;
+      case WORD_SUB: v = x - y; f = x < y; break;
+      case WORD_CMP: f = (x == y) | ((u64)(x < y) << 1); break;
+      case WORD_MUX: v = select[lane] & 1 ? y : x; break;
+      case WORD_SHL: v = y >= width ? 0 : x << y; break;
+      case WORD_SHR: v = y >= width ? 0 : x >> y; break;
+      case WORD_MUL: v = x * y; break;
+      default: break;
+    }
+    value[lane] = v & mask;
+    flags[lane] = f;
+  }
+  for (usize lane = lanes; lane < 64; lane++) {
+    value[lane] = 0;
+    flags[lane] = 0;
+  }
+
+  u64 unknown = getUnknownLanes(netlist, word, fourState);
+  usize valueWidth = getValueWidth(word->op, width);
+  scatterLanes(netlist, value, word->results, valueWidth, unknown, fourState);
+  scatterLanes(netlist, flags, word->results + valueWidth, word->numResults - valueWidth, unknown, fourState);
+}
+
+void tickNetlist(Netlist* netlist) {
+  u8* types = netlist->types;
+  u32* left = netlist->left;
+  u32* right = netlist->right;
+  u64* one = netlist->one;
+
+  for (usize i = netlist->levels[1]; i < netlist->numNodes; i++) {
+    switch (types[i]) {
+      case NAND: one[i] = ~(one[left[i]] & one[right[i]]); break;
+      case TRISTATE: one[i] = one[left[i]] & one[right[i]]; break;
+      case RESOLVE: one[i] = one[left[i]] | one[right[i]]; break; // Wired-OR without Z
+      case WORD: evaluateWord(netlist, &netlist->words[left[i]], false); break;
+      case SLICE: break; // Written by its WORD
+      default: one[i] = one[left[i]]; break;
+    }
+  }
+  storeMemories(netlist, false);
+}
+
+void tickNetlist4(Netlist* netlist) {
+  u8* types = netlist->types;
+  u32* left = netlist->left;
+  u32* right = netlist->right;
+  u64* one = netlist->one;
+  u64* zero = netlist->zero;
+
+  for (usize i = netlist->levels[1]; i < netlist->numNodes; i++) {
+    u32 l = left[i];
+    u32 r = right[i];
+    switch (types[i]) {
+      case NAND: {
+        u64 mayBeOne = zero[l] | zero[r];
+        zero[i] = one[l] & one[r];
+        one[i] = mayBeOne;
+        break;
+      }
+      case TRISTATE: {
+        u64 enabled = one[r] & ~zero[r];
+        u64 unknown = one[r] & zero[r];
+        one[i] = (enabled & one[l]) | unknown;
+        zero[i] = (enabled & zero[l]) | unknown;
+        break;
+      }
+      case RESOLVE:
+        one[i] = one[l] | one[r];
+        zero[i] = zero[l] | zero[r];
+        break;
+      case WORD: evaluateWord(netlist, &netlist->words[l], true); break;
+      case SLICE: break;
+      default: {
+        u64 floating = ~(one[l] | zero[l]);
+        one[i] = one[l] | floating;
+        zero[i] = zero[l] | floating;
+        break;
+      }
+    }
+  }
+  storeMemories(netlist, true);
+}
+
+// Collects the resolvers of a netlist and its instances where two drivers of
+// a bus are both driving and disagree, returns how many there are in total.
+// Checked over the resolvers only, after a four-state tick, so the tick itself
+// stays lean.
+usize findConflicts(Netlist* netlist, Conflict* conflicts, usize capacity, usize count) {
+  for (usize i = 0; i < netlist->numResolvers; i++) {
+    u32 net = netlist->resolvers[i];
+    u32 l = netlist->left[net];
+    u32 r = netlist->right[net];
+    u64 driven = (netlist->one[l] | netlist->zero[l]) & (netlist->one[r] | netlist->zero[r]);
+    u64 conflict = driven & netlist->one[net] & netlist->zero[net];
+    if (!conflict) continue;
+
+    if (count < capacity) {
+      conflicts[count].circuit = netlist->resolverCircuits[i];
+      conflicts[count].component = netlist->resolverComponents[i];
+      conflicts[count].lanes = conflict;
+    }
+    count++;
+  }
+
+  for (usize i = 0; i < netlist->numWords; i++) {
+    if (netlist->words[i].instance) count = findConflicts(netlist->words[i].instance, conflicts, capacity, count);
+  }
+  for (usize i = 0; i < netlist->numBatches; i++) {
+    count = findConflicts(netlist->batches[i].state, conflicts, capacity, count);
+  }
+
+  return count;
+}
+
+// Marks the BUS components with a conflict, instances share the components of
+// their definition so every BUS is cleared before any is marked
+void applyConflicts(Project* project, Conflict* conflicts, usize count, bool print) {
+  for (usize i = 0; i < project->numCircuits; i++) {
+    for (usize j = 0; j < project->circuits[i].numComponents; j++) {
+      Component* component = &project->circuits[i].components[j];
+      if (component->kind == KIND_BUS) component->state = LOGIC_0;
+    }
+  }
+
+  for (usize i = 0; i < count; i++) {
+    if (conflicts[i].circuit > project->numCircuits) continue;
+    Circuit* circuit = getCircuit(project, conflicts[i].circuit);
+    if (conflicts[i].component > circuit->numComponents) continue;
+    Component* component = getComponent(circuit, conflicts[i].component);
+    component->state = LOGIC_X;
+    if (!print) continue;
+    char* name = toCString(&circuit->name);
+    printf("Bus conflict on BUS %zu in %s (lanes %016llx)\n", component->id, name, (unsigned long long)conflicts[i].lanes);
+    free(name);
+  }
+}
+
+usize reportConflicts(Project* project, Netlist* netlist) {
+  Conflict conflicts[MAX_CONFLICTS];
+  usize count = findConflicts(netlist, conflicts, MAX_CONFLICTS, 0);
+  applyConflicts(project, conflicts, count < MAX_CONFLICTS ? count : MAX_CONFLICTS, true);
+  return count;
+}
+
+Logic getLogic(Netlist* netlist, u32 net, usize lane, bool fourState) {
+  bool one = (netlist->one[net] >> lane) & 1;
+  if (!fourState) return one ? LOGIC_1 : LOGIC_0;
+  bool zero = (netlist->zero[net] >> lane) & 1;
+  if (one && zero) return LOGIC_X;
+  if (one) return LOGIC_1;
+  if (zero) return LOGIC_0;
+  return LOGIC_Z;
+}
@@ -0,0 +1,194 @@
+#include "logicol_core.h"
+
+void setGateCapacitance(PowerModel* model, const char* kind, f64 capacitance) {
+  for (usize i = 0; i < model->numKinds; i++) {
+    if (strcmp(model->kinds[i], kind) == 0) {
+      model->capacitances[i] = capacitance;
+      return;
+    }
+  }
+  if (model->numKinds == MAX_GATE_KINDS) return;
+  snprintf(model->kinds[model->numKinds], sizeof(model->kinds[0]), "%s", kind);
+  model->capacitances[model->numKinds++] = capacitance;
+}
+
+// Rough values relative to an inverter, by the NAND count of each gate
+PowerModel createPowerModel() {
+  PowerModel model;
+  memset(&model, 0, sizeof(PowerModel));
+  model.fanout = 0.5;
+  model.voltage = 1.0;
+  const char* kinds[] = { "NOT", "AND", "OR", "TRISTATE", "BUS", "CLOCK", "ADD", "SUB", "CMP", "MUX",
+                          "SHL", "SHR", "MUL", "ROM", "RAM", "RAM2" };
+  const f64 capacitances[] = { 1, 2, 2, 1.5, 1, 1, 4, 4, 3, 2, 1, 1, 8, 2, 2, 2 };
+  for (usize i = 0; i < sizeof(kinds) / sizeof(kinds[0]); i++) setGateCapacitance(&model, kinds[i], capacitances[i]);
+  return model;
+}
+
+// Lines of `KIND fF`, FANOUT for the capacitance of each driven pin and VDD
+// for the voltage. Subcircuits can be given a capacitance of their own too.
+bool loadPowerModel(PowerModel* model, const char* path) {
+  FILE* file = fopen(path, "r");
+  if (!file) return false;
+  char kind[32];
+  f64 value;
+  char line[256];
+  while (fgets(line, sizeof(line), file)) {
+    if (line[0] == '#' || sscanf(line, "%31s %lf", kind, &value) != 2) continue;
+    if (strcmp(kind, "FANOUT") == 0) model->fanout = value;
+    else if (strcmp(kind, "VDD") == 0) model->voltage = value;
+    else setGateCapacitance(model, kind, value);
+  }
+  fclose(file);
+  return true;
+}
+
+f64 getGateCapacitance(PowerModel* model, String* kind) {
+  for (usize i = 0; i < model->numKinds; i++) {
+    if (stringEqualCString(kind, model->kinds[i])) return model->capacitances[i];
+  }
+  return 0;
+}
+
+// Pins driven by each output of each component. The first numComponents + 1
+// entries are where the outputs of each component start.
+usize* countFanouts(Circuit* circuit) {
+  usize numComponents = circuit->numComponents;
+  usize numOutputs = 0;
+  for (usize i = 0; i < numComponents; i++) numOutputs += circuit->components[i].numOutputs;
+  usize* fanouts = malloc(sizeof(usize) * (numComponents + numOutputs + 1));
+  memset(fanouts, 0, sizeof(usize) * (numComponents + numOutputs + 1));
+  for (usize i = 0; i < numComponents; i++) fanouts[i + 1] = fanouts[i] + circuit->components[i].numOutputs;
+  for (usize i = 0; i < numComponents; i++) {
+    Component* component = &circuit->components[i];
+    for (usize j = 0; j < component->numInputs; j++) {
+      Input* input = &component->inputs[j];
+      if (input->component == 0 || input->component > numComponents) continue;
+      if (input->outputIndex >= circuit->components[input->component - 1].numOutputs) continue;
+      fanouts[numComponents + 1 + fanouts[input->component - 1] + input->outputIndex]++;
+    }
+  }
+  return fanouts;
+}
+
+// Energy of every probe in fJ, or 0 for probes of components edited away
+// since the netlist was compiled
+f64* getProbeEnergies(Project* project, Coverage* coverage, PowerModel* model) {
+  usize** fanouts = malloc(sizeof(usize*) * (project->numCircuits + 1));
+  memset(fanouts, 0, sizeof(usize*) * (project->numCircuits + 1));
+  f64* energies = malloc(sizeof(f64) * (coverage->numProbes + 1));
+  for (usize i = 0; i < coverage->numProbes; i++) {
+    Probe* probe = &coverage->probes[i];
+    energies[i] = 0;
+    if (probe->circuit == 0 || probe->circuit > project->numCircuits) continue;
+    Circuit* circuit = getCircuit(project, probe->circuit);
+    if (probe->component == 0 || probe->component > circuit->numComponents) continue;
+    Component* component = getComponent(circuit, probe->component);
+    if (probe->output >= component->numOutputs) continue;
+    if (!fanouts[probe->circuit]) fanouts[probe->circuit] = countFanouts(circuit);
+    usize* counts = fanouts[probe->circuit];
+    usize fanout = counts[circuit->numComponents + 1 + counts[probe->component - 1] + probe->output];
+    f64 capacitance = getGateCapacitance(model, &component->name) + fanout * model->fanout;
+    energies[i] = 0.5 * capacitance * model->voltage * model->voltage * getProbeToggles(coverage, i);
+  }
+  for (usize i = 0; i <= project->numCircuits; i++) free(fanouts[i]);
+  free(fanouts);
+  return energies;
+}
+
+#define MAX_REPORTED_GATES 16
+
+typedef struct {
+  usize path;
+  CircuitRef circuit;
+  ComponentRef component;
+  f64 energy;
+} GateEnergy;
+
+void printEnergy(FILE* file, f64 energy, u64 ticks) {
+  fprintf(file, "%.3f pJ, %.3f fJ per tick\n", energy / 1000, ticks ? energy / ticks : 0.0);
+}
+
+// Energy per definition over all its instances, per instance, and of the
+// gates that switch the most
+void reportPower(FILE* file, Project* project, Coverage* coverage, PowerModel* model) {
+  f64* energies = getProbeEnergies(project, coverage, model);
+  u64 ticks = atomic_load(&coverage->samples);
+  f64* circuits = malloc(sizeof(f64) * (project->numCircuits + 1));
+  f64* paths = malloc(sizeof(f64) * (coverage->numPaths + 1));
+  usize* instances = malloc(sizeof(usize) * (project->numCircuits + 1));
+  memset(circuits, 0, sizeof(f64) * (project->numCircuits + 1));
+  memset(paths, 0, sizeof(f64) * (coverage->numPaths + 1));
+  memset(instances, 0, sizeof(usize) * (project->numCircuits + 1));
+
+  // Bits of a gate sum into one entry, found by (path, circuit, component)
+  Memo found = { 0 };
+  usize numGates = 0;
+  GateEnergy* gates = malloc(sizeof(GateEnergy) * (coverage->numProbes + 1));
+  f64 total = 0;
+  for (usize i = 0; i < coverage->numProbes; i++) {
+    Probe* probe = &coverage->probes[i];
+    if (probe->circuit == 0 || probe->circuit > project->numCircuits || probe->path > coverage->numPaths) continue;
+    circuits[probe->circuit] += energies[i];
+    paths[probe->path] += energies[i];
+    total += energies[i];
+    void** slot = findMemo(&found, probe->path, probe->circuit, probe->component, 0);
+    if (!*slot) {
+      gates[numGates] = (GateEnergy){ probe->path, probe->circuit, probe->component, 0 };
+      *slot = (void*)++numGates;
+    }
+    gates[(usize)*slot - 1].energy += energies[i];
+  }
+  destroyMemo(&found);
+
+  instances[coverage->root]++;
+  for (usize i = 0; i < coverage->numPaths; i++) {
+    Component* component = getComponent(getCircuit(project, coverage->paths[i].circuit), coverage->paths[i].component);
+    Circuit* definition = getDefinition(project, component);
+    if (definition) instances[definition->id]++;
+  }
+
+  // The busiest gates, by insertion into a short sorted list
+  GateEnergy top[MAX_REPORTED_GATES];
+  usize numTop = 0;
+  for (usize i = 0; i < numGates; i++) {
+    usize at = numTop < MAX_REPORTED_GATES ? numTop++ : MAX_REPORTED_GATES;
+    while (at > 0 && top[at - 1].energy < gates[i].energy) {
+      if (at < MAX_REPORTED_GATES) top[at] = top[at - 1];
+      at--;
+    }
+    if (at < MAX_REPORTED_GATES) top[at] = gates[i];
+  }
+
+  fprintf(file, "Switching energy after %llu ticks, %.2f V, %.2f fF per fanout: ", (unsigned long long)ticks,
+          model->voltage, model->fanout);
+  printEnergy(file, total, ticks);
+  for (usize i = 0; i < project->numCircuits; i++) {
+    if (!instances[i + 1]) continue;
+    char* name = toCString(&project->circuits[i].name);
+    fprintf(file, "  circuit %s, %zu instances: ", name, instances[i + 1]);
+    free(name);
+    printEnergy(file, circuits[i + 1], ticks);
+  }
+  for (usize i = 0; i <= coverage->numPaths; i++) {
+    fprintf(file, "  instance ");
+    printInstanceName(file, project, coverage, i);
+    fprintf(file, ": ");
+    printEnergy(file, paths[i], ticks);
+  }
+  for (usize i = 0; i < numTop && top[i].energy > 0; i++) {
+    Component* component = getComponent(getCircuit(project, top[i].circuit), top[i].component);
+    char* name = toCString(&component->name);
+    fprintf(file, "  gate ");
+    printInstanceName(file, project, coverage, top[i].path);
+    fprintf(file, " > %s %zu: ", name, component->id);
+    free(name);
+    printEnergy(file, top[i].energy, ticks);
+  }
+
+  free(energies);
+  free(circuits);
+  free(paths);
+  free(instances);
+  free(gates);
+}
@@ -0,0 +1,193 @@
+#include "logicol_core.h"
+
+// Widths of the INPUTs or OUTPUTs of a circuit, in the order of its ports or
+// roots
+usize getWidths(Circuit* circuit, Kind kind, usize* widths) {
+  usize count = 0;
+  for (usize i = 0; i < circuit->numComponents; i++) {
+    if (circuit->components[i].kind == kind) widths[count++] = circuit->components[i].width;
+  }
+  return count;
+}
+
+// With `cache` the netlist comes from the netlist cache when it is there and
+// goes into it otherwise
+Simulation* createSimulation(Project* project, Circuit* root, bool fourState, bool lowerWords, bool cache) {
+  Simulation* simulation = malloc(sizeof(Simulation));
+  memset(simulation, 0, sizeof(Simulation));
+  u64 hash = getDesignHash(project, root, lowerWords);
+  simulation->netlist = malloc(sizeof(Netlist));
+  if (!cache || !loadNetlist(project, root, hash, simulation->netlist)) {
+    *simulation->netlist = flattenTree(compileProject(project, root, lowerWords, false));
+    if (cache) saveNetlist(simulation->netlist, hash);
+  }
+  simulation->netlist->numLanes = 1;
+  batchInstances(simulation->netlist);
+  copyMemories(simulation->netlist);
+  simulation->fourState = fourState || simulation->netlist->needsFourState;
+  simulation->inputWidths = malloc(sizeof(usize) * (root->numComponents + 1));
+  simulation->outputWidths = malloc(sizeof(usize) * (root->numComponents + 1));
+  simulation->numInputs = getWidths(root, KIND_INPUT, simulation->inputWidths);
+  simulation->numOutputs = getWidths(root, KIND_OUTPUT, simulation->outputWidths);
+  return simulation;
+}
+
+void destroySimulation(Simulation* simulation) {
+  if (simulation->coverage) destroyCoverage(simulation->coverage);
+  destroyNetlist(simulation->netlist);
+  free(simulation->netlist);
+  free(simulation->inputWidths);
+  free(simulation->outputWidths);
+  free(simulation);
+}
+
+void setInputs(Simulation* simulation, const u64* values) {
+  for (usize i = 0, port = 0; i < simulation->numInputs; i++) {
+    setPorts(simulation->netlist, port, simulation->inputWidths[i], values[i]);
+    port += simulation->inputWidths[i];
+  }
+}
+
+// Lane 0 of the roots, read straight off the bit-planes
+void getOutputs(Simulation* simulation, u64* values, u64* unknown) {
+  Netlist* netlist = simulation->netlist;
+  usize root = 0;
+  for (usize i = 0; i < simulation->numOutputs; i++) {
+    u64 value = 0;
+    u64 mask = 0;
+    for (usize bit = 0; bit < simulation->outputWidths[i]; bit++) {
+      u32 net = netlist->roots[root++];
+      u64 one = netlist->one[net] & 1;
+      value |= one << bit;
+      if (simulation->fourState) mask |= (one ^ (netlist->zero[net] & 1) ^ 1) << bit;
+    }
+    if (values) values[i] = value & ~mask;
+    if (unknown) unknown[i] = mask;
+  }
+}
+
+// The cycles of the editor's simulator, CLOCKs are high in odd ones
+void runCycle(Simulation* simulation) {
+  simulation->cycle++;
+  setClocks(simulation->netlist, simulation->cycle & 1);
+  if (simulation->fourState) tickNetlist4(simulation->netlist);
+  else tickNetlist(simulation->netlist);
+  if (simulation->coverage) sampleCoverage(simulation->coverage, simulation->netlist);
+}
+
+// Biases are the probability of a bit being 1 in 256ths
+#define MAX_BIAS 256
+
+u16 getBias(double probability) {
+  return probability <= 0 ? 0 : probability >= 1 ? MAX_BIAS : (u16)(probability * MAX_BIAS + 0.5);
+}
+
+// Biases start out at 0.5
+Stimulus createStimulus(StimulusMode mode, u64 seed, usize numInputs, usize* widths) {
+  Stimulus stimulus = { mode, seed, numInputs, widths, NULL, 0, (u64)-1, NULL };
+  stimulus.biases = malloc(sizeof(u16) * (numInputs + 1));
+  for (usize i = 0; i < numInputs; i++) {
+    stimulus.biases[i] = getBias(0.5);
+    stimulus.numBits += widths[i];
+  }
+  stimulus.planes = malloc(sizeof(u64) * (stimulus.numBits + 1));
+  return stimulus;
+}
+
+void destroyStimulus(Stimulus* stimulus) {
+  free(stimulus->biases);
+  free(stimulus->planes);
+}
+
+// The SplitMix64 finalizer
+u64 mixBits(u64 z) {
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return z ^ (z >> 31);
+}
+
+u64 rotateLeft(u64 x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+u64 nextRandom(u64* state) {
+  u64 result = rotateLeft(state[1] * 5, 7) * 9;
+  u64 t = state[1] << 17;
+  state[2] ^= state[0];
+  state[3] ^= state[1];
+  state[1] ^= state[2];
+  state[0] ^= state[3];
+  state[2] ^= t;
+  state[3] = rotateLeft(state[3], 45);
+  return result;
+}
+
+// 64 bits that are each 1 with probability `bias` / MAX_BIAS, by folding a
+// draw in for every bit of the bias from the lowest, OR for a 1 and AND for
+// a 0
+u64 nextBiased(u64* state, u16 bias) {
+  if (bias >= MAX_BIAS) return ~(u64)0;
+  u64 bits = 0;
+  for (usize k = 0; k < 8; k++) {
+    u64 draw = nextRandom(state);
+    bits = (bias >> k) & 1 ? bits | draw : bits & draw;
+  }
+  return bits;
+}
+
+// Bit `bit` of the INPUTs in `cycle` for the modes that are no draws.
+// Counters and walking bits span the bits of all INPUTs, the first one lowest.
+bool getPatternBit(Stimulus* stimulus, u64 cycle, usize bit) {
+  switch (stimulus->mode) {
+    case STIMULUS_WALKING_ONES: return cycle % stimulus->numBits == bit;
+    case STIMULUS_WALKING_ZEROS: return cycle % stimulus->numBits != bit;
+    case STIMULUS_COUNT: return bit < 64 && ((cycle >> bit) & 1);
+    default: return false;
+  }
+}
+
+// The planes of the 64 cycles from 64 * `block` on, bit l of each for cycle
+// 64 * `block` + l. Only generated again for another block.
+u64* getStimulusBlock(Stimulus* stimulus, u64 block) {
+  if (stimulus->block == block) return stimulus->planes;
+  stimulus->block = block;
+
+  u64 state[4];
+  u64 key = mixBits(stimulus->seed) ^ block;
+  for (usize i = 0; i < 4; i++) {
+    state[i] = mixBits(key += 0x9e3779b97f4a7c15);
+  }
+
+  usize bit = 0;
+  for (usize i = 0; i < stimulus->numInputs; i++) {
+    for (usize b = 0; b < stimulus->widths[i]; b++, bit++) {
+      u64 plane = 0;
+      if (stimulus->mode == STIMULUS_UNIFORM) {
+        plane = nextRandom(state);
+      } else if (stimulus->mode == STIMULUS_BIASED) {
+        plane = nextBiased(state, stimulus->biases[i]);
+      } else {
+        for (usize lane = 0; lane < 64; lane++) {
+          plane |= (u64)getPatternBit(stimulus, block * 64 + lane, bit) << lane;
+        }
+      }
+      stimulus->planes[bit] = plane;
+    }
+  }
+  return stimulus->planes;
+}
+
+// The INPUTs of one cycle, its lane of the block it is in
+void generateStimulus(Stimulus* stimulus, u64 cycle, u64* values) {
+  if (stimulus->mode == STIMULUS_NONE) return;
+  u64* planes = getStimulusBlock(stimulus, cycle / 64);
+  usize lane = cycle % 64;
+  usize bit = 0;
+  for (usize i = 0; i < stimulus->numInputs; i++) {
+    u64 value = 0;
+    for (usize b = 0; b < stimulus->widths[i]; b++, bit++) {
+      value |= ((planes[bit] >> lane) & 1) << b;
+    }
+    values[i] = value;
+  }
+}
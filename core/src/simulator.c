@@ -0,0 +1,227 @@
+#include <time.h>
+#include "logicol_core.h"
+
+double getSeconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+void sleepSeconds(double seconds) {
+  struct timespec duration;
+  duration.tv_sec = (time_t)seconds;
+  duration.tv_nsec = (long)((seconds - duration.tv_sec) * 1e9);
+  nanosleep(&duration, NULL);
+}
+
+bool pushEvent(Queue* queue, Event event) {
+  usize tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+  usize head = atomic_load_explicit(&queue->head, memory_order_acquire);
+  if (tail - head == QUEUE_SIZE) return false;
+  queue->events[tail % QUEUE_SIZE] = event;
+  atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+  return true;
+}
+
+bool popEvent(Queue* queue, Event* event) {
+  usize head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+  usize tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+  if (head == tail) return false;
+  *event = queue->events[head % QUEUE_SIZE];
+  atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+  return true;
+}
+
+void publishSnapshot(Simulator* simulator) {
+  Netlist* netlist = simulator->netlist;
+  bool four = simulator->fourState || netlist->needsFourState;
+  Snapshot snapshot;
+  snapshot.generation = simulator->generation;
+  snapshot.ticks = simulator->ticks;
+  snapshot.numRoots = netlist->numRoots < MAX_PUBLISHED ? netlist->numRoots : MAX_PUBLISHED;
+  for (usize i = 0; i < snapshot.numRoots; i++) {
+    snapshot.roots[i] = getLogic(netlist, netlist->roots[i], 0, four);
+  }
+  snapshot.numConflicts = four ? findConflicts(netlist, snapshot.conflicts, MAX_CONFLICTS, 0) : 0;
+
+  usize sequence = atomic_load_explicit(&simulator->sequence, memory_order_relaxed);
+  atomic_store_explicit(&simulator->sequence, sequence + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  simulator->published = snapshot;
+  atomic_store_explicit(&simulator->sequence, sequence + 2, memory_order_release);
+}
+
+Snapshot readSnapshot(Simulator* simulator) {
+  Snapshot snapshot;
+  usize before, after;
+  do {
+    before = atomic_load_explicit(&simulator->sequence, memory_order_acquire);
+    snapshot = simulator->published;
+    atomic_thread_fence(memory_order_acquire);
+    after = atomic_load_explicit(&simulator->sequence, memory_order_relaxed);
+  } while ((before & 1) || before != after);
+  return snapshot;
+}
+
+void setPorts(Netlist* netlist, usize port, usize width, u64 value) {
+  for (usize bit = 0; bit < width && port + bit < netlist->numPorts; bit++) {
+    u32 net = netlist->ports[port + bit];
+    if (net == (u32)-1) continue;
+    netlist->one[net] = (value >> bit) & 1 ? ~(u64)0 : 0;
+    netlist->zero[net] = ~netlist->one[net];
+  }
+}
+
+// Every CLOCK is high in odd cycles, so it runs at half the tick rate
+void setClocks(Netlist* netlist, bool high) {
+  for (usize i = 0; i < netlist->numClocks; i++) {
+    netlist->one[netlist->clocks[i]] = high ? ~(u64)0 : 0;
+    netlist->zero[netlist->clocks[i]] = ~netlist->one[netlist->clocks[i]];
+  }
+  for (usize i = 0; i < netlist->numWords; i++) {
+    if (netlist->words[i].instance) setClocks(netlist->words[i].instance, high);
+  }
+  for (usize i = 0; i < netlist->numBatches; i++) {
+    setClocks(netlist->batches[i].state, high);
+  }
+}
+
+// A trace stops when the circuit no longer has the INPUTs and OUTPUTs it was
+// started with
+void replaceTrace(Simulator* simulator, Trace* trace) {
+  if (simulator->trace) detachTrace(simulator->trace);
+  simulator->trace = trace;
+  if (!trace || !simulator->netlist || bindTrace(trace, simulator->netlist)) return;
+  printf("Trace stopped, the INPUTs or OUTPUTs changed\n");
+  detachTrace(trace);
+  simulator->trace = NULL;
+}
+
+void replaceNetlist(Simulator* simulator, Netlist* netlist) {
+  if (simulator->netlist) {
+    if (netlist) transferMemories(simulator->netlist, netlist);
+    destroyNetlist(simulator->netlist);
+    free(simulator->netlist);
+  }
+  simulator->netlist = netlist;
+}
+
+void* runSimulator(void* data) {
+  Simulator* simulator = data;
+  double next = getSeconds();
+  double published = 0;
+
+  while (true) {
+    Event event;
+    while (popEvent(&simulator->events, &event)) {
+      switch (event.type) {
+        case EVENT_NETLIST:
+          if (simulator->coverage) atomic_store_explicit(&simulator->coverage->detached, true, memory_order_release);
+          simulator->coverage = event.coverage;
+          replaceNetlist(simulator, event.netlist);
+          destroyModules(event.retired, event.numRetired);
+          if (simulator->trace && !bindTrace(simulator->trace, simulator->netlist)) {
+            printf("Trace stopped, the INPUTs or OUTPUTs changed\n");
+            replaceTrace(simulator, NULL);
+          }
+          simulator->fourState = event.fourState;
+          simulator->generation = event.generation;
+          simulator->dirty = true;
+          break;
+        case EVENT_INPUT:
+          if (simulator->netlist) setPorts(simulator->netlist, event.port, event.width, event.value);
+          simulator->dirty = true;
+          break;
+        case EVENT_RUN:
+          simulator->running = event.running;
+          simulator->rate = event.rate;
+          next = getSeconds();
+          break;
+        case EVENT_STEP:
+          simulator->steps++;
+          break;
+        case EVENT_TRACE:
+          replaceTrace(simulator, event.trace);
+          break;
+        case EVENT_STOP:
+          if (simulator->coverage) atomic_store_explicit(&simulator->coverage->detached, true, memory_order_release);
+          replaceTrace(simulator, NULL);
+          replaceNetlist(simulator, NULL);
+          return NULL;
+      }
+    }
+
+    bool advance = simulator->running || simulator->steps;
+    if (!simulator->netlist || (!advance && !simulator->dirty)) {
+      sleepSeconds(0.001);
+      continue;
+    }
+
+    if (advance) {
+      simulator->cycles++;
+      if (simulator->steps) simulator->steps--;
+    }
+    setClocks(simulator->netlist, simulator->cycles & 1);
+    if (simulator->fourState || simulator->netlist->needsFourState) {
+      tickNetlist4(simulator->netlist);
+    } else {
+      tickNetlist(simulator->netlist);
+    }
+    simulator->ticks++;
+    if (simulator->coverage) sampleCoverage(simulator->coverage, simulator->netlist);
+    if (simulator->trace) captureTrace(simulator->trace, simulator->netlist, simulator->ticks, simulator->fourState || simulator->netlist->needsFourState);
+
+    // Paused, a change is settled with a single tick. Running, the editor
+    // only needs a snapshot about every frame.
+    double now = getSeconds();
+    if (!simulator->running || simulator->dirty || now - published > 1.0 / 120) {
+      publishSnapshot(simulator);
+      published = now;
+    }
+    simulator->dirty = false;
+
+    if (simulator->running && simulator->rate > 0) {
+      next += 1.0 / simulator->rate;
+      if (next > now) sleepSeconds(next - now);
+      else if (now - next > 0.1) next = now; // Fell behind, do not try to catch up
+    }
+  }
+}
+
+Simulator* createSimulator() {
+  Simulator* simulator = malloc(sizeof(Simulator));
+  memset(simulator, 0, sizeof(Simulator));
+  atomic_init(&simulator->events.head, 0);
+  atomic_init(&simulator->events.tail, 0);
+  atomic_init(&simulator->sequence, 0);
+  pthread_create(&simulator->thread, NULL, runSimulator, simulator);
+  return simulator;
+}
+
+// Waits while the queue is full, the simulator drains it every tick
+void sendEvent(Simulator* simulator, Event event) {
+  while (!pushEvent(&simulator->events, event)) sleepSeconds(0.0001);
+}
+
+void destroySimulator(Simulator* simulator) {
+  sendEvent(simulator, (Event){ .type = EVENT_STOP });
+  pthread_join(simulator->thread, NULL);
+  free(simulator);
+}
+
+// Compiles the circuit into a netlist the simulator can own, with its own
+// copy of the RAM contents. Given a cache the netlist is hierarchical and
+// only edited modules compile again. Otherwise it comes from the netlist cache
+// on disk when it is there, and is flattened from scratch when it is not.
+Netlist* compileSimulation(Project* project, Circuit* circuit, bool lowerWords, ModuleCache* cache) {
+  Netlist* netlist = malloc(sizeof(Netlist));
+  if (cache) {
+    *netlist = compileIncremental(project, circuit, cache, lowerWords);
+  } else if (!loadNetlist(project, circuit, getDesignHash(project, circuit, lowerWords), netlist)) {
+    *netlist = flattenTree(compileProject(project, circuit, lowerWords, false));
+  }
+  netlist->numLanes = 1;
+  batchInstances(netlist);
+  copyMemories(netlist);
+  return netlist;
+}
@@ -0,0 +1,193 @@
+#include "logicol_core.h"
+
+// Traces record the root's INPUTs and OUTPUTs every tick. A frame holds the
+// Logic of every traced bit in 2 bits, a record is the tick it starts at
+// followed by its frame and is only written when the frame changes. Records
+// go into a ring of bounded size, read by the VCD writer thread and the
+// waveform pane, either of which may fall behind and lose the oldest. A
+// blocking trace makes the simulation wait for the writer instead.
+#define TRACE_BYTES (16 << 20)
+
+Logic getTracedBit(u64* frame, usize bit) {
+  return (frame[bit / 32] >> (bit % 32 * 2)) & 3;
+}
+
+// Points the traced bits at the nets of a netlist, false when it has a
+// different number of ports or roots than the trace was started with
+bool bindTrace(Trace* trace, Netlist* netlist) {
+  if (netlist->numPorts != trace->numPorts || netlist->numRoots != trace->numBits - trace->numPorts) return false;
+  for (usize i = 0; i < trace->numPorts; i++) {
+    trace->nets[i] = netlist->ports[i];
+  }
+  for (usize i = 0; i < netlist->numRoots; i++) {
+    trace->nets[trace->numPorts + i] = netlist->roots[i];
+  }
+  return true;
+}
+
+void captureTrace(Trace* trace, Netlist* netlist, u64 tick, bool fourState) {
+  u64 written = atomic_load_explicit(&trace->written, memory_order_relaxed);
+  while (trace->blocking && written - atomic_load_explicit(&trace->read, memory_order_acquire) >= trace->capacity - 1) {
+    sleepSeconds(0.0001);
+  }
+  u64* record = &trace->records[(written % trace->capacity) * trace->recordWords];
+  memset(record + 1, 0, sizeof(u64) * trace->frameWords);
+  for (usize i = 0; i < trace->numBits; i++) {
+    u32 net = trace->nets[i];
+    u64 value = net == (u32)-1 ? LOGIC_X : getLogic(netlist, net, 0, fourState);
+    record[1 + i / 32] |= value << (i % 32 * 2);
+  }
+
+  atomic_store_explicit(&trace->lastTick, tick, memory_order_release);
+  if (written != 0 && memcmp(record + 1, trace->frame, sizeof(u64) * trace->frameWords) == 0) return;
+  record[0] = tick;
+  memcpy(trace->frame, record + 1, sizeof(u64) * trace->frameWords);
+  atomic_store_explicit(&trace->written, written + 1, memory_order_release);
+}
+
+// Copies record `index` out of the ring, false when it has been overwritten
+// or is being overwritten
+bool readRecord(Trace* trace, u64 index, u64* record) {
+  memcpy(record, &trace->records[(index % trace->capacity) * trace->recordWords], sizeof(u64) * trace->recordWords);
+  atomic_thread_fence(memory_order_acquire);
+  return atomic_load_explicit(&trace->written, memory_order_relaxed) - index < trace->capacity;
+}
+
+// VCD identifiers are base 94 in the printable characters
+void getVcdId(char* id, usize index) {
+  do {
+    *id++ = 33 + index % 94;
+    index /= 94;
+  } while (index);
+  *id = 0;
+}
+
+void writeVcdValue(FILE* file, Signal* signal, u64* frame, usize index) {
+  const char digits[] = "01xz";
+  char id[8];
+  getVcdId(id, index);
+  if (signal->width == 1) {
+    fprintf(file, "%c%s\n", digits[getTracedBit(frame, signal->first)], id);
+    return;
+  }
+  fputc('b', file);
+  for (usize bit = signal->width; bit-- > 0;) {
+    fputc(digits[getTracedBit(frame, signal->first + bit)], file);
+  }
+  fprintf(file, " %s\n", id);
+}
+
+void* runTraceWriter(void* data) {
+  Trace* trace = data;
+  u64* record = malloc(sizeof(u64) * trace->recordWords);
+  u64* previous = malloc(sizeof(u64) * trace->frameWords);
+  u64 read = 0;
+  u64 dropped = 0;
+
+  while (true) {
+    bool stopping = atomic_load_explicit(&trace->stopping, memory_order_acquire);
+    u64 written = atomic_load_explicit(&trace->written, memory_order_acquire);
+    if (read == written) {
+      if (stopping) break;
+      sleepSeconds(0.001);
+      continue;
+    }
+    if (written - read >= trace->capacity) {
+      dropped += written - read - (trace->capacity - 1);
+      read = written - (trace->capacity - 1);
+    }
+    if (!readRecord(trace, read, record)) continue;
+
+    fprintf(trace->file, "#%llu\n", (unsigned long long)record[0]);
+    if (read == 0) fprintf(trace->file, "$dumpvars\n");
+    for (usize i = 0; i < trace->numSignals; i++) {
+      Signal* signal = &trace->signals[i];
+      bool changed = read == 0;
+      for (usize bit = 0; bit < signal->width && !changed; bit++) {
+        changed = getTracedBit(record + 1, signal->first + bit) != getTracedBit(previous, signal->first + bit);
+      }
+      if (changed) writeVcdValue(trace->file, signal, record + 1, i);
+    }
+    if (read == 0) fprintf(trace->file, "$end\n");
+    memcpy(previous, record + 1, sizeof(u64) * trace->frameWords);
+    read++;
+    atomic_store_explicit(&trace->read, read, memory_order_release);
+  }
+
+  fprintf(trace->file, "#%llu\n", (unsigned long long)atomic_load(&trace->lastTick) + 1);
+  fclose(trace->file);
+  if (dropped) printf("Trace writer fell behind, %llu changes not written\n", (unsigned long long)dropped);
+  free(record);
+  free(previous);
+  return NULL;
+}
+
+// Starts tracing the INPUTs and OUTPUTs of a circuit into a VCD file, the
+// simulator is handed the trace with EVENT_TRACE
+Trace* createTrace(Circuit* root, const char* path) {
+  FILE* file = fopen(path, "w");
+  if (!file) {
+    printf("Cannot write %s\n", path);
+    return NULL;
+  }
+
+  Trace* trace = malloc(sizeof(Trace));
+  memset(trace, 0, sizeof(Trace));
+  Kind kinds[] = { KIND_INPUT, KIND_OUTPUT };
+  for (usize k = 0; k < 2; k++) {
+    for (usize i = 0; i < root->numComponents; i++) {
+      Component* component = &root->components[i];
+      if (component->kind != kinds[k]) continue;
+      trace->numSignals++;
+      trace->signals = realloc(trace->signals, sizeof(Signal) * trace->numSignals);
+      Signal* signal = &trace->signals[trace->numSignals - 1];
+      snprintf(signal->name, sizeof(signal->name), "%s_%zu", KIND_NAMES[kinds[k]], component->id);
+      signal->width = component->width;
+      signal->first = trace->numBits;
+      trace->numBits += component->width;
+    }
+    if (k == 0) trace->numPorts = trace->numBits;
+  }
+  trace->frameWords = trace->numBits / 32 + 1;
+  trace->recordWords = 1 + trace->frameWords;
+  trace->capacity = TRACE_BYTES / (sizeof(u64) * trace->recordWords);
+  trace->records = malloc(sizeof(u64) * trace->recordWords * trace->capacity);
+  trace->nets = malloc(sizeof(u32) * trace->numBits);
+  trace->frame = malloc(sizeof(u64) * trace->frameWords);
+  atomic_init(&trace->written, 0);
+  atomic_init(&trace->lastTick, 0);
+  atomic_init(&trace->read, 0);
+  atomic_init(&trace->stopping, false);
+  atomic_init(&trace->detached, false);
+
+  char* name = toCString(&root->name);
+  fprintf(file, "$version Logicol $end\n$timescale 1ns $end\n$scope module %s $end\n", name);
+  free(name);
+  for (usize i = 0; i < trace->numSignals; i++) {
+    char id[8];
+    getVcdId(id, i);
+    fprintf(file, "$var wire %zu %s %s $end\n", trace->signals[i].width, id, trace->signals[i].name);
+  }
+  fprintf(file, "$upscope $end\n$enddefinitions $end\n");
+
+  trace->file = file;
+  pthread_create(&trace->writer, NULL, runTraceWriter, trace);
+  return trace;
+}
+
+// Called by the simulator when it lets go of the trace, the writer finishes
+// what is left in the ring
+void detachTrace(Trace* trace) {
+  atomic_store_explicit(&trace->stopping, true, memory_order_release);
+  atomic_store_explicit(&trace->detached, true, memory_order_release);
+}
+
+// Only once the simulator has detached it
+void destroyTrace(Trace* trace) {
+  pthread_join(trace->writer, NULL);
+  free(trace->signals);
+  free(trace->records);
+  free(trace->nets);
+  free(trace->frame);
+  free(trace);
+}
@@ -0,0 +1,561 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "logicol_core.h"
+
+// The simulator without the editor, for batch runs on machines without a
+// display, the sim package. It links core and no raylib:
+//   cc -O2 -Icore/include sim/src/main.c core/src/*.c -lm -lpthread -o logicol-sim
+// It simulates one circuit of a project for a number of cycles, taking the
+// INPUTs from a stimulus file or a generator and writing the OUTPUTs of every
+// cycle and optionally a VCD trace. With test vectors it checks the OUTPUTs
+// instead and only reports the vectors that fail.
+
+typedef struct {
+  const char* project;
+  const char* circuit;
+  const char* stimulus;
+  const char* outputs;
+  const char* waveform;
+  const char* vectors;
+  const char* biases;
+  const char* coverage;
+  const char* power;
+  const char* capacitances;
+  StimulusMode generator;
+  u64 seed;
+  u64 cycles;
+  bool fourState;
+  bool lowerWords;
+  bool quiet;
+  bool echo;
+} Options;
+
+void printUsage() {
+  fprintf(stderr,
+    "usage: logicol-sim [options] project.logic\n"
+    "  -c NAME   circuit to simulate, the first one by default\n"
+    "  -n COUNT  cycles to run, by default one per stimulus line or 1\n"
+    "  -i FILE   stimulus, a line per cycle of hex values, one per INPUT in order,\n"
+    "            - reads stdin\n"
+    "  -g MODE   generated stimulus, uniform, biased, ones, zeros or count, where\n"
+    "            ones and zeros walk a single bit across the INPUTs\n"
+    "  -s SEED   seed of the random stimulus, together with the cycle it gives\n"
+    "            the same vector every time\n"
+    "  -b P,...  probability of a 1 in each INPUT for biased stimulus, the last\n"
+    "            one repeats, 0.5 by default\n"
+    "  -o FILE   writes the OUTPUTs of each cycle there instead of stdout\n"
+    "  -w FILE   traces the INPUTs and OUTPUTs into a VCD file\n"
+    "  -C FILE   writes the toggle coverage of every circuit and instance there\n"
+    "  -P FILE   writes the switching energy of every circuit, instance and the\n"
+    "            busiest gates there\n"
+    "  -k FILE   capacitances for -P, lines of a gate kind, FANOUT or VDD and a\n"
+    "            value in fF or V\n"
+    "  -t FILE   runs the test vectors of a binary or text file and reports the\n"
+    "            ones that fail, text lines are INPUTs : expected OUTPUTs in hex\n"
+    "  -q        does not write the OUTPUTs\n"
+    "  -e        writes the INPUTs of each cycle too, in the test vector format\n"
+    "  -4        four-state simulation\n"
+    "  -l        lowers word ops to gates\n");
+}
+
+bool parseOptions(int argc, char** argv, Options* options) {
+  memset(options, 0, sizeof(Options));
+  for (int i = 1; i < argc; i++) {
+    char* arg = argv[i];
+    bool value = arg[0] == '-' && arg[1] && strchr("cnigsowtbCPk", arg[1]) && !arg[2];
+    if (value && i + 1 >= argc) return false;
+    if (value) i++;
+    if (strcmp(arg, "-c") == 0) options->circuit = argv[i];
+    else if (strcmp(arg, "-n") == 0) options->cycles = strtoull(argv[i], NULL, 0);
+    else if (strcmp(arg, "-i") == 0) options->stimulus = argv[i];
+    else if (strcmp(arg, "-s") == 0) options->seed = strtoull(argv[i], NULL, 0);
+    else if (strcmp(arg, "-o") == 0) options->outputs = argv[i];
+    else if (strcmp(arg, "-w") == 0) options->waveform = argv[i];
+    else if (strcmp(arg, "-t") == 0) options->vectors = argv[i];
+    else if (strcmp(arg, "-b") == 0) options->biases = argv[i];
+    else if (strcmp(arg, "-C") == 0) options->coverage = argv[i];
+    else if (strcmp(arg, "-P") == 0) options->power = argv[i];
+    else if (strcmp(arg, "-k") == 0) options->capacitances = argv[i];
+    else if (strcmp(arg, "-g") == 0 && strcmp(argv[i], "uniform") == 0) options->generator = STIMULUS_UNIFORM;
+    else if (strcmp(arg, "-g") == 0 && strcmp(argv[i], "biased") == 0) options->generator = STIMULUS_BIASED;
+    else if (strcmp(arg, "-g") == 0 && strcmp(argv[i], "ones") == 0) options->generator = STIMULUS_WALKING_ONES;
+    else if (strcmp(arg, "-g") == 0 && strcmp(argv[i], "zeros") == 0) options->generator = STIMULUS_WALKING_ZEROS;
+    else if (strcmp(arg, "-g") == 0 && strcmp(argv[i], "count") == 0) options->generator = STIMULUS_COUNT;
+    else if (strcmp(arg, "-q") == 0) options->quiet = true;
+    else if (strcmp(arg, "-e") == 0) options->echo = true;
+    else if (strcmp(arg, "-4") == 0) options->fourState = true;
+    else if (strcmp(arg, "-l") == 0) options->lowerWords = true;
+    else if (arg[0] != '-' && !options->project) options->project = arg;
+    else return false;
+  }
+  bool stimulus = options->stimulus || options->generator || options->cycles || options->waveform;
+  return options->project && !(options->stimulus && options->generator) && !(options->vectors && stimulus);
+}
+
+// Reads the next stimulus line into `values`, false at the end of the file.
+// Values missing from the line keep what they were.
+bool readStimulus(FILE* file, u64* values, usize count) {
+  static char* line = NULL;
+  static size_t capacity = 0;
+  while (getline(&line, &capacity, file) != -1) {
+    char* at = line;
+    while (*at == ' ' || *at == '\t') at++;
+    if (*at == '#' || *at == '\n' || *at == 0) continue;
+    for (usize i = 0; i < count; i++) {
+      char* end;
+      u64 value = strtoull(at, &end, 16);
+      if (end == at) break;
+      values[i] = value;
+      at = end;
+    }
+    return true;
+  }
+  return false;
+}
+
+// A hex value per OUTPUT, x when any bit is unknown and z when all of them float
+void writeOutputs(FILE* file, Simulation* simulation, usize lane) {
+  Netlist* netlist = simulation->netlist;
+  usize root = 0;
+  for (usize i = 0; i < simulation->numOutputs; i++) {
+    u64 word = 0;
+    bool unknown = false;
+    bool floating = true;
+    for (usize bit = 0; bit < simulation->outputWidths[i]; bit++) {
+      Logic value = getLogic(netlist, netlist->roots[root++], lane, simulation->fourState);
+      if (value == LOGIC_1) word |= (u64)1 << bit;
+      if (value == LOGIC_X) unknown = true;
+      if (value != LOGIC_Z) floating = false;
+    }
+    if (i) fputc(' ', file);
+    if (unknown) fputc('x', file);
+    else if (floating) fputc('z', file);
+    else fprintf(file, "%llx", (unsigned long long)word);
+  }
+  fputc('\n', file);
+}
+
+// A circuit without CLOCKs, RAMs or batched calls has no state between
+// cycles, so its lanes can run independent cycles
+bool canPackLanes(Netlist* netlist) {
+  return !netlist->numClocks && !netlist->hasStores && !netlist->numBatches;
+}
+
+// Runs `count` cycles of INPUT bit-planes in one tick, one in each lane
+void runLanes(Simulation* simulation, u64* planes, usize numBits, usize count) {
+  Netlist* netlist = simulation->netlist;
+  netlist->numLanes = count;
+  for (usize bit = 0; bit < numBits && bit < netlist->numPorts; bit++) {
+    u32 net = netlist->ports[bit];
+    if (net == (u32)-1) continue;
+    netlist->one[net] = planes[bit];
+    netlist->zero[net] = ~planes[bit];
+  }
+  runCycle(simulation);
+  simulation->cycle += count - 1;
+}
+
+// Test vectors come in blocks of 64, a bit-plane per INPUT bit followed by
+// one per expected OUTPUT bit and one per OUTPUT bit that is checked, bit l
+// of each plane belonging to vector l. Binary files are a header of u64
+// VECTORS_MAGIC, VECTORS_VERSION, INPUT bits, OUTPUT bits and vectors
+// followed by the blocks, used in place. Text files have a line per vector of
+// hex values for the INPUTs, a colon and the expected OUTPUTs, where x checks
+// nothing, and are packed into blocks as they are read. Either is mapped and
+// released again behind the reader, so files of any size stream through.
+#define VECTORS_MAGIC 0x4c56454c
+#define VECTORS_VERSION 1
+#define VECTORS_RELEASE (16 << 20)
+
+typedef struct {
+  u8* mapping;
+  usize size;
+  usize pointer;
+  usize released;
+  bool text;
+  u64 numVectors;
+  u64 numRead;
+  usize numInputBits;
+  usize numOutputBits;
+  usize blockWords;
+  u64* block;
+} Vectors;
+
+bool openVectors(Vectors* vectors, const char* path, Simulation* simulation) {
+  memset(vectors, 0, sizeof(Vectors));
+  int file = open(path, O_RDONLY);
+  struct stat info;
+  if (file < 0 || fstat(file, &info) != 0 || info.st_size == 0) {
+    fprintf(stderr, "Cannot read %s\n", path);
+    if (file >= 0) close(file);
+    return false;
+  }
+  vectors->size = info.st_size;
+  vectors->mapping = mmap(NULL, vectors->size, PROT_READ, MAP_PRIVATE, file, 0);
+  close(file);
+  if (vectors->mapping == MAP_FAILED) {
+    fprintf(stderr, "Cannot map %s\n", path);
+    return false;
+  }
+  madvise(vectors->mapping, vectors->size, MADV_SEQUENTIAL);
+
+  vectors->numInputBits = simulation->netlist->numPorts;
+  vectors->numOutputBits = simulation->netlist->numRoots;
+  vectors->blockWords = vectors->numInputBits + 2 * vectors->numOutputBits;
+  u64 header[5] = { 0 };
+  if (vectors->size >= sizeof(header)) memcpy(header, vectors->mapping, sizeof(header));
+  if (header[0] != VECTORS_MAGIC) {
+    vectors->text = true;
+    vectors->block = malloc(sizeof(u64) * vectors->blockWords);
+    return true;
+  }
+
+  vectors->numVectors = header[4];
+  vectors->pointer = sizeof(header);
+  u64 numBlocks = (vectors->numVectors + 63) / 64;
+  bool valid = header[1] == VECTORS_VERSION && header[2] == vectors->numInputBits &&
+               header[3] == vectors->numOutputBits &&
+               (vectors->size - sizeof(header)) / sizeof(u64) / (vectors->blockWords ? vectors->blockWords : 1) >= numBlocks;
+  if (!valid) {
+    fprintf(stderr, "%s is not for a circuit with %zu INPUT and %zu OUTPUT bits\n", path, vectors->numInputBits, vectors->numOutputBits);
+    munmap(vectors->mapping, vectors->size);
+    return false;
+  }
+  return true;
+}
+
+void closeVectors(Vectors* vectors) {
+  munmap(vectors->mapping, vectors->size);
+  free(vectors->block);
+}
+
+bool parseHex(u8** at, u8* end, u64* value) {
+  while (*at < end && (**at == ' ' || **at == '\t')) (*at)++;
+  u8* start = *at;
+  *value = 0;
+  for (; *at < end; (*at)++) {
+    u8 c = **at;
+    u64 digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : 16;
+    if (digit == 16) break;
+    *value = (*value << 4) | digit;
+  }
+  return *at != start;
+}
+
+// Packs the next line of a text file into lane `lane` of the block, false at
+// the end of the file
+bool readVectorLine(Vectors* vectors, Simulation* simulation, usize lane) {
+  u8* end = vectors->mapping + vectors->size;
+  while (vectors->pointer < vectors->size) {
+    u8* at = vectors->mapping + vectors->pointer;
+    u8* newline = memchr(at, '\n', end - at);
+    u8* lineEnd = newline ? newline : end;
+    vectors->pointer = newline ? (usize)(newline + 1 - vectors->mapping) : vectors->size;
+    while (at < lineEnd && (*at == ' ' || *at == '\t' || *at == '\r')) at++;
+    if (at == lineEnd || *at == '#') continue;
+
+    u64* inputs = vectors->block;
+    u64* expected = inputs + vectors->numInputBits;
+    u64* care = expected + vectors->numOutputBits;
+    usize bit = 0;
+    for (usize i = 0; i < simulation->numInputs; i++) {
+      u64 value = 0;
+      parseHex(&at, lineEnd, &value);
+      for (usize b = 0; b < simulation->inputWidths[i]; b++, bit++) {
+        inputs[bit] |= ((value >> b) & 1) << lane;
+      }
+    }
+    while (at < lineEnd && *at != ':') at++;
+    if (at < lineEnd) at++;
+    bit = 0;
+    for (usize i = 0; i < simulation->numOutputs; i++) {
+      u64 value = 0;
+      bool checked = parseHex(&at, lineEnd, &value);
+      if (!checked && at < lineEnd && (*at == 'x' || *at == 'X')) at++;
+      for (usize b = 0; b < simulation->outputWidths[i]; b++, bit++) {
+        expected[bit] |= ((value >> b) & 1) << lane;
+        care[bit] |= (u64)checked << lane;
+      }
+    }
+    return true;
+  }
+  return false;
+}
+
+// Points `block` at the next block and returns how many vectors it holds, 0
+// at the end
+usize readVectors(Vectors* vectors, Simulation* simulation, u64** block) {
+  // Drops the pages already read, they are not needed again
+  usize done = vectors->pointer & ~(usize)4095;
+  if (done - vectors->released >= VECTORS_RELEASE) {
+    madvise(vectors->mapping + vectors->released, done - vectors->released, MADV_DONTNEED);
+    vectors->released = done;
+  }
+
+  if (vectors->text) {
+    memset(vectors->block, 0, sizeof(u64) * vectors->blockWords);
+    usize count = 0;
+    while (count < 64 && readVectorLine(vectors, simulation, count)) count++;
+    *block = vectors->block;
+    vectors->numRead += count;
+    return count;
+  }
+
+  if (vectors->numRead >= vectors->numVectors) return 0;
+  usize count = vectors->numVectors - vectors->numRead < 64 ? vectors->numVectors - vectors->numRead : 64;
+  *block = (u64*)(vectors->mapping + vectors->pointer);
+  vectors->pointer += sizeof(u64) * vectors->blockWords;
+  vectors->numRead += count;
+  return count;
+}
+
+void reportMismatch(FILE* file, Simulation* simulation, u64 index, usize lane, u64* expected, u64* care, u64* got, u64* unknown) {
+  usize bit = 0;
+  for (usize i = 0; i < simulation->numOutputs; i++) {
+    u64 want = 0, mask = 0, value = 0, bad = 0;
+    for (usize b = 0; b < simulation->outputWidths[i]; b++, bit++) {
+      want |= ((expected[bit] >> lane) & 1) << b;
+      mask |= ((care[bit] >> lane) & 1) << b;
+      value |= ((got[bit] >> lane) & 1) << b;
+      bad |= ((unknown[bit] >> lane) & 1) << b;
+    }
+    if (!(((want ^ value) | bad) & mask)) continue;
+    fprintf(file, "vector %llu: OUTPUT %zu expected %llx", (unsigned long long)index, i, (unsigned long long)want);
+    if (mask != getWidthMask(simulation->outputWidths[i])) fprintf(file, " (mask %llx)", (unsigned long long)mask);
+    if (bad) fprintf(file, " got x\n");
+    else fprintf(file, " got %llx\n", (unsigned long long)value);
+  }
+}
+
+// Runs every vector and reports the ones whose OUTPUTs differ from what they
+// expect, returns how many did. A circuit without state between cycles runs
+// 64 vectors a tick, one in each lane. Otherwise the vectors are consecutive
+// cycles in lane 0.
+u64 runVectors(Simulation* simulation, Vectors* vectors, FILE* report) {
+  Netlist* netlist = simulation->netlist;
+  bool packed = canPackLanes(netlist);
+  if (packed) netlist->numLanes = 64;
+  usize numInputBits = vectors->numInputBits;
+  usize numOutputBits = vectors->numOutputBits;
+  u64* got = malloc(sizeof(u64) * (numOutputBits + 1));
+  u64* unknown = malloc(sizeof(u64) * (numOutputBits + 1));
+  u64 index = 0;
+  u64 mismatches = 0;
+
+  u64* block;
+  usize count;
+  while ((count = readVectors(vectors, simulation, &block)) != 0) {
+    u64* inputs = block;
+    u64* expected = block + numInputBits;
+    u64* care = expected + numOutputBits;
+
+    if (packed) {
+      for (usize bit = 0; bit < numInputBits; bit++) {
+        u32 net = netlist->ports[bit];
+        if (net == (u32)-1) continue;
+        netlist->one[net] = inputs[bit];
+        netlist->zero[net] = ~inputs[bit];
+      }
+      runCycle(simulation);
+      for (usize bit = 0; bit < numOutputBits; bit++) {
+        u32 net = netlist->roots[bit];
+        got[bit] = netlist->one[net];
+        unknown[bit] = simulation->fourState ? ~(netlist->one[net] ^ netlist->zero[net]) : 0;
+      }
+    } else {
+      memset(got, 0, sizeof(u64) * numOutputBits);
+      memset(unknown, 0, sizeof(u64) * numOutputBits);
+      for (usize lane = 0; lane < count; lane++) {
+        for (usize bit = 0; bit < numInputBits; bit++) {
+          setPorts(netlist, bit, 1, inputs[bit] >> lane);
+        }
+        runCycle(simulation);
+        for (usize bit = 0; bit < numOutputBits; bit++) {
+          u32 net = netlist->roots[bit];
+          got[bit] |= (netlist->one[net] & 1) << lane;
+          if (simulation->fourState) unknown[bit] |= (~(netlist->one[net] ^ netlist->zero[net]) & 1) << lane;
+        }
+      }
+    }
+
+    // Whole planes compare 64 vectors at a time, in a loop the compiler
+    // vectorizes further
+    u64 failed = 0;
+    for (usize bit = 0; bit < numOutputBits; bit++) {
+      failed |= ((got[bit] ^ expected[bit]) | unknown[bit]) & care[bit];
+    }
+    failed &= count == 64 ? ~(u64)0 : ((u64)1 << count) - 1;
+    for (usize lane = 0; failed; lane++, failed >>= 1) {
+      if (!(failed & 1)) continue;
+      reportMismatch(report, simulation, index + lane, lane, expected, care, got, unknown);
+      mismatches++;
+    }
+    index += count;
+  }
+
+  free(got);
+  free(unknown);
+  return mismatches;
+}
+
+// Writes and closes the report files that were asked for
+void writeReports(FILE* coverage, FILE* power, Project* project, Coverage* measured, PowerModel* model) {
+  if (coverage) {
+    reportCoverage(coverage, project, measured);
+    fclose(coverage);
+  }
+  if (power) {
+    reportPower(power, project, measured, model);
+    fclose(power);
+  }
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parseOptions(argc, argv, &options)) {
+    printUsage();
+    return 2;
+  }
+
+  Project project = loadProject(options.project);
+  if (!project.numCircuits) return 1;
+  Circuit* root = &project.circuits[0];
+  if (options.circuit) {
+    String name = fromCString(options.circuit);
+    root = findCircuit(&project, &name);
+    destroyString(&name);
+    if (!root) {
+      fprintf(stderr, "No circuit %s in %s\n", options.circuit, options.project);
+      return 1;
+    }
+  }
+
+  FILE* stimulus = NULL;
+  if (options.stimulus) {
+    stimulus = strcmp(options.stimulus, "-") == 0 ? stdin : fopen(options.stimulus, "r");
+    if (!stimulus) {
+      fprintf(stderr, "Cannot read %s\n", options.stimulus);
+      return 1;
+    }
+  }
+  FILE* outputs = options.outputs ? fopen(options.outputs, "w") : stdout;
+  if (!outputs) {
+    fprintf(stderr, "Cannot write %s\n", options.outputs);
+    return 1;
+  }
+  setvbuf(outputs, NULL, _IOFBF, 1 << 20);
+
+  // The first run of a design caches its netlist, later ones only map it
+  Simulation* simulation = createSimulation(&project, root, options.fourState, options.lowerWords, true);
+  FILE* coverage = NULL;
+  if (options.coverage) {
+    coverage = fopen(options.coverage, "w");
+    if (!coverage) {
+      fprintf(stderr, "Cannot write %s\n", options.coverage);
+      return 1;
+    }
+  }
+  FILE* power = NULL;
+  PowerModel model = createPowerModel();
+  if (options.power) {
+    power = fopen(options.power, "w");
+    if (!power) {
+      fprintf(stderr, "Cannot write %s\n", options.power);
+      return 1;
+    }
+  }
+  if (options.capacitances && !loadPowerModel(&model, options.capacitances)) {
+    fprintf(stderr, "Cannot read %s\n", options.capacitances);
+    return 1;
+  }
+  if (coverage || power) simulation->coverage = createCoverage(simulation->netlist);
+
+  if (options.vectors) {
+    Vectors vectors;
+    if (!openVectors(&vectors, options.vectors, simulation)) return 1;
+    double start = getSeconds();
+    u64 mismatches = runVectors(simulation, &vectors, outputs);
+    fprintf(stderr, "%llu vectors in %.3f s, %llu failed\n", (unsigned long long)vectors.numRead, getSeconds() - start,
+            (unsigned long long)mismatches);
+    closeVectors(&vectors);
+    writeReports(coverage, power, &project, simulation->coverage, &model);
+    if (outputs != stdout) fclose(outputs);
+    destroySimulation(simulation);
+    destroyProject(&project);
+    return mismatches ? 1 : 0;
+  }
+  u64* values = malloc(sizeof(u64) * (simulation->numInputs + 1));
+  for (usize i = 0, k = 0; i < root->numComponents; i++) {
+    if (root->components[i].kind == KIND_INPUT) values[k++] = root->components[i].outputs[0];
+  }
+
+  Trace* trace = NULL;
+  if (options.waveform) {
+    trace = createTrace(root, options.waveform);
+    if (!trace) return 1;
+    trace->blocking = true;
+    bindTrace(trace, simulation->netlist);
+  }
+
+  // A stimulus file without a cycle count runs until it ends, otherwise its
+  // last line holds once it ends
+  bool untilEnd = stimulus && !options.cycles;
+  u64 cycles = options.cycles ? options.cycles : 1;
+  Stimulus generator = createStimulus(options.generator, options.seed, simulation->numInputs, simulation->inputWidths);
+  const char* bias = options.biases;
+  for (usize i = 0; bias && i < simulation->numInputs; i++) {
+    generator.biases[i] = getBias(strtod(bias, NULL));
+    bias = strchr(bias, ',') ? strchr(bias, ',') + 1 : bias;
+  }
+  double start = getSeconds();
+
+  // Generated stimulus of a circuit without state runs a block of 64 cycles
+  // a tick, one in each lane. Traces and coverage follow the cycles in order.
+  bool packed = generator.mode && !stimulus && !trace && !simulation->coverage && canPackLanes(simulation->netlist);
+  while (packed && simulation->cycle < cycles) {
+    u64 first = simulation->cycle;
+    usize count = cycles - first < 64 ? cycles - first : 64;
+    runLanes(simulation, getStimulusBlock(&generator, first / 64), generator.numBits, count);
+    for (usize lane = 0; lane < count && !options.quiet; lane++) {
+      if (options.echo) {
+        generateStimulus(&generator, first + lane, values);
+        for (usize i = 0; i < simulation->numInputs; i++) {
+          fprintf(outputs, "%llx ", (unsigned long long)values[i]);
+        }
+        fputs(": ", outputs);
+      }
+      writeOutputs(outputs, simulation, lane);
+    }
+  }
+
+  while (!packed && (simulation->cycle < cycles || untilEnd)) {
+    if (stimulus && !readStimulus(stimulus, values, simulation->numInputs) && untilEnd) break;
+    if (generator.mode) generateStimulus(&generator, simulation->cycle, values);
+    setInputs(simulation, values);
+    runCycle(simulation);
+    if (trace) captureTrace(trace, simulation->netlist, simulation->cycle, simulation->fourState);
+    if (!options.quiet && options.echo) {
+      for (usize i = 0; i < simulation->numInputs; i++) {
+        fprintf(outputs, "%llx ", (unsigned long long)values[i]);
+      }
+      fputs(": ", outputs);
+    }
+    if (!options.quiet) writeOutputs(outputs, simulation, 0);
+  }
+  fprintf(stderr, "%llu cycles in %.3f s\n", (unsigned long long)simulation->cycle, getSeconds() - start);
+
+  if (trace) {
+    detachTrace(trace);
+    destroyTrace(trace);
+  }
+  writeReports(coverage, power, &project, simulation->coverage, &model);
+  if (stimulus && stimulus != stdin) fclose(stimulus);
+  if (outputs != stdout) fclose(outputs);
+  destroySimulation(simulation);
+  destroyProject(&project);
+  destroyStimulus(&generator);
+  free(values);
+  return 0;
+}
@@ -4,266 +4,336 @@
 #include "math.h"
 #include "memory.h"
 #include "stdlib.h"
+#include "logicol_core.h"
 
-typedef int8_t   i8;
-typedef int16_t  i16;
-typedef int32_t  i32;
-typedef int64_t  i64;
-typedef uint8_t  u8;
-typedef uint16_t u16;
-typedef uint32_t u32;
-typedef uint64_t u64; 
-typedef float    f32;
-typedef double   f64;
-typedef size_t   usize;
-
-typedef struct {
-  usize length;
-  char* data;
-} String;
-
-String createString() {
-  String string;
-  string.length = 0;
-  string.data = NULL;
-  return string;
-}
-
-void destroyString(String* string) {
-  free(string->data);
-}
-
-String fromCString(const char* data) {
-  String string;
-  string.length = strlen(data);
-  string.data = malloc(sizeof(char) * string.length);
-  memcpy(string.data, data, sizeof(char) * string.length);
-  return string;
-}
-
-void appendString(String* base, String* extra) {
-  usize old = base->length;
-  base->length += extra->length;
-  base->data = realloc(base->data, sizeof(char) * base->length);
-  memcpy(&base->data[old], extra->data, sizeof(char) * extra->length);
-}
+#define PURPLE (Color){ 126, 34, 206, 255 }
+#define BACKGROUND (Color){ 15, 23, 42, 255 }
 
-bool stringEqual(String* a, String* b) {
-  if (a->length != b->length) return false;
+static f32 FONT_SIZE = 48.0;
+static f32 FONT_SPACING = 8.0;
 
-  for (usize i = 0; i < a->length; i++) {
-    if (a->data[i] != b->data[i]) return false;
+// Text measurement dominates drawing big circuits, so a component's box is
+// measured once, components are never renamed or renumbered. The ends of
+// its pins, inputs then outputs, follow it when it moves or changes width.
+void layoutComponent(Component* component) {
+  if (!component->measured) {
+    free(component->nameText);
+    component->nameText = toCString(&component->name);
+    component->nameSize = MeasureTextEx(GetFontDefault(), component->nameText, FONT_SIZE, FONT_SPACING);
+    sprintf(component->idText, "%zu", component->id);
+    component->idSize = MeasureTextEx(GetFontDefault(), component->idText, FONT_SIZE, FONT_SPACING);
+    component->size = (Vector2){ component->nameSize.x + 32.0, component->nameSize.y + component->idSize.y + 24.0 };
+    component->measured = true;
+    free(component->pins);
+    component->pins = NULL;
   }
 
-  return true;
+  if (component->pins && component->layoutPos.x == component->pos.x && component->layoutPos.y == component->pos.y &&
+      component->layoutInputs == component->numInputs && component->layoutOutputs == component->numOutputs) return;
+  component->pins = realloc(component->pins, sizeof(Vector2) * (component->numInputs + component->numOutputs + 1));
+  Vector2 pos = component->pos;
+  Vector2 size = component->size;
+  for (usize i = 0; i < component->numInputs; i++) {
+    component->pins[i] = (Vector2){ pos.x - 32, pos.y + (size.y * (i + 1)) / (component->numInputs + 1) };
+  }
+  for (usize i = 0; i < component->numOutputs; i++) {
+    component->pins[component->numInputs + i] = (Vector2){ pos.x + size.x + 32, pos.y + (size.y * (i + 1)) / (component->numOutputs + 1) };
+  }
+  component->layoutPos = pos;
+  component->layoutInputs = component->numInputs;
+  component->layoutOutputs = component->numOutputs;
 }
 
-char* toCString(String* string) {
-  char* buffer = malloc(sizeof(char) * (string->length + 1));
-  memset(buffer, 0, sizeof(char) * (string->length + 1));
-  memcpy(buffer, string->data, sizeof(char) * string->length);
-  return buffer;
+Vector2 getSize(Component* component) {
+  layoutComponent(component);
+  return component->size;
 }
 
-String cloneString(String* base) {
-  String string;
-  string.length = base->length;
-  string.data = malloc(sizeof(char) * base->length);
-  memcpy(string.data, base->data, sizeof(char) * base->length);
-  return string;
+Vector2 getInputPos(Component* component, usize input) {
+  layoutComponent(component);
+  return component->pins[input];
 }
 
-#define PURPLE (Color){ 126, 34, 206, 255 }
-#define BACKGROUND (Color){ 15, 23, 42, 255 }
-
-static f32 FONT_SIZE = 48.0;
-static f32 FONT_SPACING = 8.0;
-
-typedef struct Component Component;
-typedef usize ComponentRef;
-typedef usize CircuitRef;
+// Connections can name an output an instance no longer has until they are
+// redrawn, those end below the box
+Vector2 getOutputPos(Component* component, usize output) {
+  layoutComponent(component);
+  if (output < component->numOutputs) return component->pins[component->numInputs + output];
+  Vector2 size = component->size;
+  return (Vector2){ component->pos.x + size.x + 32, component->pos.y + (size.y * (output + 1)) / (component->numOutputs + 1) };
+}
 
-typedef struct {
-	usize outputIndex;
-	ComponentRef component;
-} Input;
-
-typedef struct Component {
-	ComponentRef id;
-	Vector2 pos;
-	String name;
-	usize numInputs;
-	Input* inputs;
-	usize numOutputs;
-	bool* outputs;
-	bool ticked;
-} Component;
+// How close a click has to be to a component's corner or a pin to hit it
+#define PICK_RADIUS 25.0
+#define GRID_CELL 128.0
 
-typedef struct {
-  CircuitRef id;
-	usize numComponents;
-	Component* components;
-  String name;
-} Circuit;
-
-typedef struct {
-  usize numCircuits;
-  Circuit* circuits;
-} Project;
-
-Project createProject() {
-  Project project;
-  project.numCircuits = 0;
-  project.circuits = NULL;
-  return project;
+// Everywhere a click can hit the component, its box and pins
+Rectangle getHitBounds(Component* component) {
+  Vector2 size = getSize(component);
+  return (Rectangle){ component->pos.x - 32 - PICK_RADIUS, component->pos.y - PICK_RADIUS,
+                      size.x + 64 + 2 * PICK_RADIUS, size.y + 2 * PICK_RADIUS };
 }
 
-CircuitRef addCircuit(Project* project, String name) {
-  project->numCircuits++;
-  project->circuits = realloc(project->circuits, project->numCircuits * sizeof *project->circuits);
-	Circuit* circuit = &project->circuits[project->numCircuits - 1];
-  circuit->id = project->numCircuits;
-  circuit->numComponents = 0;
-  circuit->components = NULL;
-  circuit->name = name;
-  printf("%d\n", name.length);
-  printf("%d\n", circuit->name.length);
-	return circuit->id;
+i32 getCellCoord(f32 coord) {
+  f32 cell = floorf(coord / GRID_CELL);
+  if (!(cell > -1e9)) return -1000000000;
+  if (cell > 1e9) return 1000000000;
+  return (i32)cell;
 }
 
-Circuit* getCircuit(Project* project, CircuitRef ref) {
-  return &project->circuits[ref - 1];
+usize getCellSlot(Grid* grid, i32 x, i32 y) {
+  u64 key = ((u64)(u32)x << 32) | (u32)y;
+  return ((key * 0x9e3779b97f4a7c15ull) >> 32) & (grid->capacity - 1);
 }
 
-Component* getComponent(Circuit* circuit, ComponentRef ref) {
-	return &circuit->components[ref - 1];
+GridCell* findCell(Grid* grid, i32 x, i32 y) {
+  if (!grid->capacity) return NULL;
+  for (usize slot = getCellSlot(grid, x, y); grid->cells[slot].capacity; slot = (slot + 1) & (grid->capacity - 1)) {
+    if (grid->cells[slot].x == x && grid->cells[slot].y == y) return &grid->cells[slot];
+  }
+  return NULL;
 }
 
-ComponentRef addComponent(Circuit* circuit, String name, usize numInputs, usize numOutputs) {
-	Component component;
-	component.pos = (Vector2){ 100, 100 };
-	component.id = circuit->numComponents + 1;
-	component.name = name;
-	component.numInputs = numInputs;
-	component.inputs = malloc(sizeof *component.inputs * numInputs);
-	memset(component.inputs, 0, sizeof *component.inputs * numInputs);
-	component.numOutputs = numOutputs;
-	component.outputs = malloc(sizeof(bool) * component.numOutputs);
-	memset(component.outputs, 0, sizeof(bool) * component.numOutputs);
-	component.ticked = false;
-
-	circuit->numComponents++;
-	circuit->components = realloc(circuit->components, circuit->numComponents * sizeof *circuit->components);
-	circuit->components[circuit->numComponents - 1] = component;
-	return component.id;
+GridCell* addCell(Grid* grid, i32 x, i32 y) {
+  if ((grid->numCells + 1) * 2 > grid->capacity) {
+    Grid grown = { grid->capacity ? grid->capacity * 2 : 64, grid->numCells, NULL, grid->numFiled };
+    grown.cells = calloc(grown.capacity, sizeof(GridCell));
+    for (usize i = 0; i < grid->capacity; i++) {
+      if (!grid->cells[i].capacity) continue;
+      usize slot = getCellSlot(&grown, grid->cells[i].x, grid->cells[i].y);
+      while (grown.cells[slot].capacity) slot = (slot + 1) & (grown.capacity - 1);
+      grown.cells[slot] = grid->cells[i];
+    }
+    free(grid->cells);
+    *grid = grown;
+  }
+  usize slot = getCellSlot(grid, x, y);
+  while (grid->cells[slot].capacity) slot = (slot + 1) & (grid->capacity - 1);
+  grid->numCells++;
+  grid->cells[slot] = (GridCell){ x, y, 0, 4, malloc(sizeof(ComponentRef) * 4) };
+  return &grid->cells[slot];
 }
 
-void addConnection(Circuit* circuit, ComponentRef from, ComponentRef to, usize fromIndex, usize toIndex) {
-	Component* t = getComponent(circuit, to);	
-	Component* f = getComponent(circuit, from);
-
-  if (t->inputs[toIndex].component == from && t->inputs[toIndex].outputIndex == fromIndex) { // Delete connection
-    t->inputs[toIndex].component = 0;
-	  t->inputs[toIndex].outputIndex = 0;
-    return;
+// Files the component in the cells its hit bounds overlap, and takes it out
+// of the ones it has left since. Only the cells it enters or leaves are
+// touched, so dragging a component costs the same on any sheet.
+void gridComponent(Circuit* circuit, Component* component) {
+  Rectangle bounds = getHitBounds(component);
+  i32 left = getCellCoord(bounds.x);
+  i32 top = getCellCoord(bounds.y);
+  i32 right = getCellCoord(bounds.x + bounds.width);
+  i32 bottom = getCellCoord(bounds.y + bounds.height);
+  if (component->filed && component->cellLeft == left && component->cellTop == top &&
+      component->cellRight == right && component->cellBottom == bottom) return;
+
+  Grid* grid = &circuit->grid;
+  for (i32 y = component->cellTop; component->filed && y <= component->cellBottom; y++) {
+    for (i32 x = component->cellLeft; x <= component->cellRight; x++) {
+      if (x >= left && x <= right && y >= top && y <= bottom) continue;
+      GridCell* cell = findCell(grid, x, y);
+      for (usize i = 0; i < cell->numComponents; i++) {
+        if (cell->components[i] != component->id) continue;
+        cell->components[i] = cell->components[--cell->numComponents];
+        break;
+      }
+    }
+  }
+  for (i32 y = top; y <= bottom; y++) {
+    for (i32 x = left; x <= right; x++) {
+      if (component->filed && x >= component->cellLeft && x <= component->cellRight &&
+          y >= component->cellTop && y <= component->cellBottom) continue;
+      GridCell* cell = findCell(grid, x, y);
+      if (!cell) cell = addCell(grid, x, y);
+      if (cell->numComponents == cell->capacity) {
+        cell->capacity *= 2;
+        cell->components = realloc(cell->components, sizeof(ComponentRef) * cell->capacity);
+      }
+      cell->components[cell->numComponents++] = component->id;
+    }
   }
+  component->filed = true;
+  component->cellLeft = left;
+  component->cellTop = top;
+  component->cellRight = right;
+  component->cellBottom = bottom;
+}
 
-	t->inputs[toIndex].component = from;
-	t->inputs[toIndex].outputIndex = fromIndex;
+int compareRefs(const void* a, const void* b) {
+  ComponentRef x = *(const ComponentRef*)a;
+  ComponentRef y = *(const ComponentRef*)b;
+  return (x > y) - (x < y);
 }
 
-Vector2 getSize(Component* component) {
-  char* buffer = toCString(&component->name);
-	Vector2 textSize = MeasureTextEx(GetFontDefault(), buffer, FONT_SIZE, FONT_SPACING);
-  free(buffer);
+// The components whose hit bounds overlap `area`, in the order they were
+// placed so callers choose between overlapping ones as a scan of all of them
+// would. Valid until the next query.
+usize queryGrid(Circuit* circuit, Rectangle area, ComponentRef** found) {
+  static usize capacity = 0;
+  static ComponentRef* results = NULL;
+
+  Grid* grid = &circuit->grid;
+  while (grid->numFiled < circuit->numComponents) {
+    gridComponent(circuit, &circuit->components[grid->numFiled]);
+    grid->numFiled++;
+  }
 
-	char idStr[(int)((ceil(log10(component->id))+1)*sizeof(char))];
-	Vector2 idSize = MeasureTextEx(GetFontDefault(), idStr, FONT_SIZE, FONT_SPACING);
-	
-	return (Vector2){ textSize.x + 32.0, textSize.y + idSize.y + 24.0 };
-}
+  i32 left = getCellCoord(area.x);
+  i32 top = getCellCoord(area.y);
+  i32 right = getCellCoord(area.x + area.width);
+  i32 bottom = getCellCoord(area.y + area.height);
+  u64 columns = (u64)((i64)right - left + 1);
+  u64 numArea = columns * (u64)((i64)bottom - top + 1);
+  // A large area is cheaper to cover by going through the cells there are
+  bool everyCell = numArea > grid->numCells;
+  usize numResults = 0;
+  for (usize i = 0; i < (everyCell ? grid->capacity : numArea); i++) {
+    GridCell* cell;
+    if (everyCell) {
+      cell = &grid->cells[i];
+      if (!cell->capacity || cell->x < left || cell->x > right || cell->y < top || cell->y > bottom) continue;
+    } else {
+      cell = findCell(grid, left + (i32)(i % columns), top + (i32)(i / columns));
+      if (!cell) continue;
+    }
+    if (!cell->numComponents) continue;
+    if (numResults + cell->numComponents > capacity) {
+      capacity = (numResults + cell->numComponents) * 2;
+      results = realloc(results, sizeof(ComponentRef) * capacity);
+    }
+    memcpy(&results[numResults], cell->components, sizeof(ComponentRef) * cell->numComponents);
+    numResults += cell->numComponents;
+  }
 
-Vector2 getInputPos(Component* component, usize input) {
-	Vector2 rect = getSize(component);
-	Vector2 start = { component->pos.x, component->pos.y + (rect.y * (input + 1))/(component->numInputs + 1) };
-	return (Vector2){ start.x - 32, start.y };
+  // Components spanning several cells are found once per cell
+  if (numResults) qsort(results, numResults, sizeof(ComponentRef), compareRefs);
+  usize numUnique = 0;
+  for (usize i = 0; i < numResults; i++) {
+    if (numUnique == 0 || results[numUnique - 1] != results[i]) results[numUnique++] = results[i];
+  }
+  *found = results;
+  return numUnique;
 }
 
-Vector2 getOutputPos(Component* component, usize output) {
-	Vector2 rect = getSize(component);
-	Vector2 start = { component->pos.x + rect.x, component->pos.y + (rect.y * (output + 1))/(component->numOutputs + 1) };
-	return (Vector2){ start.x + 32, start.y };
+usize queryPoint(Circuit* circuit, Vector2 point, ComponentRef** found) {
+  return queryGrid(circuit, (Rectangle){ point.x, point.y, 0, 0 }, found);
 }
 
-void drawComponent(Circuit* circuit, Component* component) {
+void drawComponent(Project* project, Circuit* circuit, Component* component) {
 	f32 x = component->pos.x;
 	f32 y = component->pos.y;
 
-  char* buffer = toCString(&component->name);
-	Vector2 textSize = MeasureTextEx(GetFontDefault(), buffer, FONT_SIZE, FONT_SPACING);
-  free(buffer);
-
-	char idStr[(int)((ceil(log10(component->id))+1)*sizeof(char))];
-	sprintf(idStr, "%zu", component->id);
-	Vector2 idSize = MeasureTextEx(GetFontDefault(), idStr, FONT_SIZE, FONT_SPACING);
-	
-	Rectangle rect = { x, y, textSize.x + 32.0, textSize.y + idSize.y + 24.0 };
+  layoutComponent(component);
+	Vector2 idSize = component->idSize;
+	Rectangle rect = { x, y, component->size.x, component->size.y };
 
 	Color color = PURPLE;
-  String input = fromCString("INPUT");
-  String output = fromCString("OUTPUT");
-	if (stringEqual(&component->name, &input)) {
+	if (component->kind == KIND_INPUT) {
 		if (component->outputs[0]) {
 			color = GREEN;
 		} else {
 			color = RED;
 		}
 	}
-  if (stringEqual(&component->name, &output)) {
+  if (component->kind == KIND_OUTPUT) {
     if (component->inputs[0].component != 0 && getComponent(circuit, component->inputs[0].component)->outputs[component->inputs[0].outputIndex]) {
 			color = GREEN;
 		} else {
 			color = RED;
 		}
+    if (component->state == LOGIC_X) color = YELLOW;
+    if (component->state == LOGIC_Z) color = GRAY;
+  }
+  if (component->kind == KIND_BUS && component->state == LOGIC_X) {
+    color = YELLOW;
   }
-  destroyString(&input);
-  destroyString(&output);
 
 	DrawRectangleLinesEx(rect, 6.0, color);
-	DrawTextEx(GetFontDefault(), idStr, (Vector2){ x + ((rect.width - idSize.x) / 2), y + 8 }, FONT_SIZE, FONT_SPACING, color);
-
-  buffer = toCString(&component->name);
-	DrawTextEx(GetFontDefault(), buffer, (Vector2){x + 16, y + idSize.y + 16.0 }, FONT_SIZE, FONT_SPACING, color);
-  free(buffer);
+	DrawTextEx(GetFontDefault(), component->idText, (Vector2){ x + ((rect.width - idSize.x) / 2), y + 8 }, FONT_SIZE, FONT_SPACING, color);
+	DrawTextEx(GetFontDefault(), component->nameText, (Vector2){x + 16, y + idSize.y + 16.0 }, FONT_SIZE, FONT_SPACING, color);
 	
 	for (usize i = 0; i < component->numInputs; i++) {
-		Vector2 start = { x, y + (rect.height * (i + 1))/(component->numInputs + 1) };
-		Vector2 end = { start.x - 32, start.y };
-		DrawLineEx(start, end, 6.0, PURPLE);
+		Vector2 end = component->pins[i];
+		Vector2 start = { x, end.y };
+    f32 thickness = getInputWidth(project, component, i) > 1 ? 14.0 : 6.0;
+		DrawLineEx(start, end, thickness, PURPLE);
 
 
 		if (component->inputs[i].component != 0) {
 			Component* connected = getComponent(circuit, component->inputs[i].component);
-			Vector2 connectedSize = getSize(connected);
-			Vector2 owo = (Vector2){ 
-				connected->pos.x + connectedSize.x + 32, 
-				connected->pos.y + connectedSize.y * (f32)(component->inputs[i].outputIndex + 1.0)/(f32)(connected->numOutputs + 1) };
+			Vector2 owo = getOutputPos(connected, component->inputs[i].outputIndex);
       Color connectionColor = RED;
       if (connected->outputs[component->inputs[i].outputIndex]) { connectionColor = GREEN; }
-			DrawLineBezier(end, owo, 6.0, connectionColor);
+      if (component->criticalPin == i) {
+        DrawLineBezier(end, owo, thickness + 8.0, ORANGE);
+      }
+			DrawLineBezier(end, owo, thickness, connectionColor);
 		}
 
 	}
 
 	for (usize i = 0; i < component->numOutputs; i++) {
-		Vector2 start = { x + rect.width, y + (rect.height * (i + 1))/(component->numOutputs + 1) };
-		DrawLineEx(start, (Vector2){ start.x + 32, start.y }, 6.0, PURPLE);
+		Vector2 end = component->pins[component->numInputs + i];
+    f32 thickness = getOutputWidth(project, component, i) > 1 ? 14.0 : 6.0;
+		DrawLineEx((Vector2){ end.x - 32, end.y }, end, thickness, PURPLE);
 	}
+
+  f32 below = y + rect.height + 8.0;
+  if (component->width > 1 || isMemory(component)) {
+    char widthStr[48];
+    if (isMemory(component)) {
+      sprintf(widthStr, "%llu x %zu bit", 1ull << component->addressWidth, component->width);
+    } else if (component->kind == KIND_INPUT) {
+      sprintf(widthStr, "%zu bit 0x%llx", component->width, (unsigned long long)component->outputs[0]);
+    } else if (component->kind == KIND_OUTPUT && component->inputs[0].component != 0) {
+      Input* input = &component->inputs[0];
+      u64 value = getComponent(circuit, input->component)->outputs[input->outputIndex];
+      sprintf(widthStr, "%zu bit 0x%llx", component->width, (unsigned long long)value);
+    } else {
+      sprintf(widthStr, "%zu bit", component->width);
+    }
+    DrawTextEx(GetFontDefault(), widthStr, (Vector2){ x, below }, FONT_SIZE / 2, FONT_SPACING / 2, color);
+    below += FONT_SIZE / 2;
+  }
+
+  if (component->kind == KIND_OUTPUT && circuit->timingValid && !circuit->timingLoop) {
+    usize depth = getPinArrival(circuit, component, 0, (TimingSources){ true, 0, true });
+    char depthStr[32];
+    sprintf(depthStr, "depth %zu", depth);
+    Color depthColor = component->criticalPin == 0 ? ORANGE : PURPLE;
+    DrawTextEx(GetFontDefault(), depthStr, (Vector2){ x, below }, FONT_SIZE / 2, FONT_SPACING / 2, depthColor);
+  }
 }
 
-void drawCircuit(Circuit* circuit) {
+// Toggle coverage and switching energy of the output bits of a component.
+// `level` goes from 0 without toggles to 1 for the most toggled component of
+// the circuit, or the one using the most energy.
+typedef struct {
+  f32 level;
+  usize covered;
+  usize bits;
+  f64 energy;
+} Heat;
+
+// Shades the component from blue to red by how often its outputs toggle, and
+// counts the bits that have not gone both ways yet. With `power` the shade
+// is by energy, which is shown instead.
+void drawHeat(Component* component, Heat* heat, bool power) {
+  Vector2 size = getSize(component);
+  Rectangle rect = { component->pos.x, component->pos.y, size.x, size.y };
+  Color color = { (u8)(255 * heat->level), 64, (u8)(255 * (1 - heat->level)), 255 };
+  DrawRectangleRec(rect, ColorAlpha(color, 0.4));
+  if (!power && heat->covered == heat->bits) return;
+  char text[48];
+  if (power) sprintf(text, "%.1f fJ", heat->energy);
+  else sprintf(text, "%zu/%zu toggled", heat->covered, heat->bits);
+  DrawTextEx(GetFontDefault(), text, (Vector2){ rect.x, rect.y - FONT_SIZE / 2 - 4 }, FONT_SIZE / 2, FONT_SPACING / 2, ORANGE);
+}
+
+// `heat` has an entry per component, or is NULL without coverage
+void drawCircuit(Project* project, Circuit* circuit, Heat* heat, bool power) {
 	for (usize i = 0; i < circuit->numComponents; i++) {
-		drawComponent(circuit, &circuit->components[i]);
+    if (heat && heat[i].bits) drawHeat(&circuit->components[i], &heat[i], power);
+		drawComponent(project, circuit, &circuit->components[i]);
 	}
 }
 
@@ -277,9 +347,11 @@ void moveComponent(Circuit* circuit, Camera2D camera) {
 	Vector2 mousePos = GetScreenToWorld2D(GetMousePosition(), camera);
 
 	if (!IsKeyDown(KEY_LEFT_CONTROL) && IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
-		for (usize i = 0; i < circuit->numComponents; i++) {
-			if (distanceBetween(mousePos, circuit->components[i].pos) < 25.0) {
-				moving = circuit->components[i].id;
+		ComponentRef* found;
+		usize numFound = queryPoint(circuit, mousePos, &found);
+		for (usize i = 0; i < numFound; i++) {
+			if (distanceBetween(mousePos, getComponent(circuit, found[i])->pos) < PICK_RADIUS) {
+				moving = found[i];
 			}
 		}
 	}
@@ -289,6 +361,7 @@ void moveComponent(Circuit* circuit, Camera2D camera) {
 		Vector2 mouseDelta = GetMouseDelta();
 		component->pos.x += mouseDelta.x / camera.zoom;
 		component->pos.y += mouseDelta.y / camera.zoom;
+		gridComponent(circuit, component);
 	}
 
 	if (IsMouseButtonReleased(MOUSE_BUTTON_LEFT)) {
@@ -296,18 +369,20 @@ void moveComponent(Circuit* circuit, Camera2D camera) {
 	}
 }
 
-void createConnection(Circuit* circuit, Camera2D camera) {
+void createConnection(Project* project, Circuit* circuit, Camera2D camera) {
 	static ComponentRef from = 0;
 	static usize output = 0;
 
 	Vector2 mousePos = GetScreenToWorld2D(GetMousePosition(), camera);
 
 	if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
-		for (usize i = 0; i < circuit->numComponents; i++) {
-			for (usize j = 0; j < circuit->components[i].numOutputs; j++) {
-				Vector2 outputPos = getOutputPos(&circuit->components[i], j);
-				if (distanceBetween(mousePos, outputPos) < 25.0) {
-					from = circuit->components[i].id;
+		ComponentRef* found;
+		usize numFound = queryPoint(circuit, mousePos, &found);
+		for (usize i = 0; i < numFound; i++) {
+			Component* component = getComponent(circuit, found[i]);
+			for (usize j = 0; j < component->numOutputs; j++) {
+				if (distanceBetween(mousePos, getOutputPos(component, j)) < PICK_RADIUS) {
+					from = component->id;
 					output = j;
 				}
 			}
@@ -319,11 +394,13 @@ void createConnection(Circuit* circuit, Camera2D camera) {
 	}
 
 	if (from && IsMouseButtonReleased(MOUSE_BUTTON_LEFT)) {
-		for (usize i = 0; i < circuit->numComponents; i++) {
-			for (usize j = 0; j < circuit->components[i].numInputs; j++) {
-				Vector2 inputPos = getInputPos(&circuit->components[i], j);
-				if (distanceBetween(mousePos, inputPos) < 25.0) {
-					addConnection(circuit, from, circuit->components[i].id, output, j);
+		ComponentRef* found;
+		usize numFound = queryPoint(circuit, mousePos, &found);
+		for (usize i = 0; i < numFound; i++) {
+			Component* component = getComponent(circuit, found[i]);
+			for (usize j = 0; j < component->numInputs; j++) {
+				if (distanceBetween(mousePos, getInputPos(component, j)) < PICK_RADIUS) {
+					addConnection(project, circuit, from, component->id, output, j);
 					from = 0;
 					output = 0;
 				}
@@ -332,22 +409,44 @@ void createConnection(Circuit* circuit, Camera2D camera) {
 	}
 }
 
-void toggleInput(Circuit* circuit, Camera2D camera) {
+ComponentRef toggleInput(Circuit* circuit, Camera2D camera) {
   Vector2 mousePos = GetScreenToWorld2D(GetMousePosition(), camera);
 
-  String input = fromCString("INPUT");
+  ComponentRef toggled = 0;
 
 	if (IsMouseButtonPressed(MOUSE_BUTTON_RIGHT)) {
-		for (usize i = 0; i < circuit->numComponents; i++) {
-			if (stringEqual(&circuit->components[i].name, &input)) {
-				if (distanceBetween(mousePos, circuit->components[i].pos) < 25.0) {
-					circuit->components[i].outputs[0] = !circuit->components[i].outputs[0];
+		ComponentRef* found;
+		usize numFound = queryPoint(circuit, mousePos, &found);
+		for (usize i = 0; i < numFound; i++) {
+			Component* component = getComponent(circuit, found[i]);
+			if (component->kind == KIND_INPUT) {
+				if (distanceBetween(mousePos, component->pos) < PICK_RADIUS) {
+					component->outputs[0] = (component->outputs[0] + 1) & getWidthMask(component->width);
+          toggled = component->id;
 				}
 			}
 		} 
 	}
 
-  destroyString(&input);
+  return toggled;
+}
+
+void changeWidth(Project* project, Circuit* circuit, Camera2D camera) {
+  Vector2 mousePos = GetScreenToWorld2D(GetMousePosition(), camera);
+
+  if (IsKeyPressed(KEY_UP) || IsKeyPressed(KEY_DOWN)) {
+    ComponentRef* found;
+    usize numFound = queryPoint(circuit, mousePos, &found);
+    for (usize i = 0; i < numFound; i++) {
+      Component* component = getComponent(circuit, found[i]);
+      if (distanceBetween(mousePos, component->pos) >= PICK_RADIUS) continue;
+      if (IsKeyDown(KEY_LEFT_SHIFT)) {
+        setAddressWidth(project, circuit, component, IsKeyPressed(KEY_UP) ? component->addressWidth + 1 : component->addressWidth - 1);
+      } else {
+        setWidth(project, circuit, component, IsKeyPressed(KEY_UP) ? component->width + 1 : component->width - 1);
+      }
+    }
+  }
 }
 
 void moveCamera(Camera2D* camera) {
@@ -373,16 +472,17 @@ CircuitRef getActive(Project* project, Circuit* active) {
   static CircuitRef* previous = NULL;
 
   if (IsKeyDown(KEY_LEFT_CONTROL) && IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
-    for (usize i = 0; i < active->numComponents; i++) {
-      if (distanceBetween(GetMousePosition(), active->components[i].pos) < 25.0) {
-        for (usize j = 0; j < project->numCircuits; j++) {
-          if (stringEqual(&project->circuits[j].name, &active->components[i].name)) {
-            numPrevious++;
-            previous = realloc(previous, numPrevious * sizeof *previous);
-            previous[numPrevious - 1] = active->id;
-            return j + 1;
-          }
-        }     
+    ComponentRef* found;
+    usize numFound = queryPoint(active, GetMousePosition(), &found);
+    for (usize i = 0; i < numFound; i++) {
+      if (distanceBetween(GetMousePosition(), getComponent(active, found[i])->pos) < PICK_RADIUS) {
+        Circuit* definition = getDefinition(project, getComponent(active, found[i]));
+        if (definition) {
+          numPrevious++;
+          previous = realloc(previous, numPrevious * sizeof *previous);
+          previous[numPrevious - 1] = active->id;
+          return definition->id;
+        }
       }
     }
   }
@@ -397,9 +497,23 @@ CircuitRef getActive(Project* project, Circuit* active) {
   return active->id;
 }
 
-void drawActive(Circuit* circuit) {
+void drawActive(Circuit* circuit, bool fourState, bool lowerWords, bool hierarchical, bool stale) {
   String editing = fromCString("Editing: ");
   appendString(&editing, &circuit->name);
+  char depth[128];
+  if (circuit->timingLoop) {
+    sprintf(depth, " (combinational loop)");
+  } else {
+    sprintf(depth, " (depth %zu)", circuit->depth);
+  }
+  if (fourState) strcat(depth, " [0/1/X/Z]");
+  if (lowerWords) strcat(depth, " [gates]");
+  if (hierarchical) strcat(depth, " [hierarchy]");
+  if (circuit->numInstances) sprintf(depth + strlen(depth), " used %zu times", circuit->numInstances);
+  if (stale) strcat(depth, hierarchical ? " [SPACE compiles the edits]" : " [SPACE compiles it all]");
+  String depthStr = fromCString(depth);
+  appendString(&editing, &depthStr);
+  destroyString(&depthStr);
   char* buffer = toCString(&editing);
   printf("%s\n", toCString(&circuit->name));
   DrawTextEx(GetFontDefault(), buffer, (Vector2){ 16.0, 16.0 }, FONT_SIZE, FONT_SPACING, PURPLE);
@@ -407,350 +521,140 @@ void drawActive(Circuit* circuit) {
   destroyString(&editing);
 }
 
-void updateInputs(Project* project, Circuit* active) {
-  usize numInputs = 0;
-  String input = fromCString("INPUT");
-  for (usize i = 0; i < active->numComponents; i++) {
-    if (stringEqual(&active->components[i].name, &input)) {
-      numInputs++;
-    }
-  }
-  destroyString(&input);
-
-  for (usize i = 0; i < project->numCircuits; i++) {
-    for (usize j = 0; j < project->circuits[i].numComponents; j++) {
-      if (stringEqual(&project->circuits[i].components[j].name, &active->name)) {
-        project->circuits[i].components[j].numInputs = numInputs;
-        project->circuits[i].components[j].inputs = realloc(project->circuits[i].components[j].inputs, sizeof(Input) * numInputs);
-        memset(&project->circuits[i].components[j].inputs[numInputs - 1], 0, sizeof(Input));
-      }
-    }
-  }
-}
-
-void updateOutputs(Project* project, Circuit* active) {
-  usize numOutputs = 0;
-  String output = fromCString("OUTPUT");
-  for (usize i = 0; i < active->numComponents; i++) {
-    if (stringEqual(&active->components[i].name, &output)) {
-      numOutputs++;
-    }
-  }
-  destroyString(&output);
-
-  for (usize i = 0; i < project->numCircuits; i++) {
-    for (usize j = 0; j < project->circuits[i].numComponents; j++) {
-      if (stringEqual(&project->circuits[i].components[j].name, &active->name)) {
-        project->circuits[i].components[j].numOutputs = numOutputs;
-        project->circuits[i].components[j].outputs = realloc(project->circuits[i].components[j].outputs, sizeof(bool) * numOutputs);
-        project->circuits[i].components[j].outputs[numOutputs - 1] = false;
-      }
+// Places a component of a built-in kind, or an instance of the circuit of
+// that name with the pins of its ports when there is one
+ComponentRef placeComponent(Project* project, Circuit* circuit, String name, usize numInputs, usize numOutputs) {
+  Kind kind = getKind(&name);
+  Circuit* definition = kind == KIND_INPUT || kind == KIND_OUTPUT ? NULL : findCircuit(project, &name);
+  if (definition) {
+    numInputs = 0;
+    numOutputs = 0;
+    for (usize i = 0; i < definition->numComponents; i++) {
+      if (definition->components[i].kind == KIND_INPUT) numInputs++;
+      if (definition->components[i].kind == KIND_OUTPUT) numOutputs++;
     }
   }
+  ComponentRef added = addComponent(project, circuit, name, numInputs, numOutputs);
+  resolveInstance(project, circuit, getComponent(circuit, added));
+  return added;
 }
 
-typedef enum NodeType {
-  NAND = 0, 
-  INPUT, 
-} NodeType;
-typedef struct Node Node;
-typedef struct Node {
-  Node* left;
-  Node* right;
-  bool ticked;
-  bool output;
-  NodeType type;
-} Node;
-
-typedef struct {
-  usize numRoots;
-  Node* roots;
-} Tree;
-
-void resetNodes(Node* node) {
-  node->ticked = false;
-  if (node->left) resetNodes(node->left);
-  if (node->right) resetNodes(node->left);
-}
-
-bool tickNode(Node* node) {
-  if (!node) return false;
-  if (node->ticked) return node->output;
-  node->ticked = true;
-
-  if (node->type == NAND) {
-    if (!node->left || !node->right) printf("PANIC\n");
-    node->output = !(tickNode(node->left) && tickNode(node->right));
+// Where the circuit is used, one line per instance
+void printInstances(Project* project, Circuit* circuit) {
+  char* name = toCString(&circuit->name);
+  printf("%s is used %zu times\n", name, circuit->numInstances);
+  free(name);
+  for (usize i = 0; i < circuit->numInstances; i++) {
+    char* owner = toCString(&getCircuit(project, circuit->instances[i].circuit)->name);
+    printf("  in %s as %zu\n", owner, circuit->instances[i].component);
+    free(owner);
   }
-
-  return node->output;
 }
 
-Node* createNode() {
-  Node* node = malloc(sizeof(Node));
-  memset(node, 0, sizeof(Node));
-  return node;
-}
-
-typedef struct Parent Parent;
-typedef struct Parent {
-  Component* component;
-  Circuit* circuit;
-  Parent* parent;
-  Circuit* root;
-} Parent;
-
-void compileComponent(Node* node, Project* project, Circuit* circuit, Input* input, Parent* parent) {
-  memset(node, 0, sizeof(Node));
-  if (input->component == 0) return;
-  Component* component = getComponent(circuit, input->component);
-
-  String and = fromCString("AND");
-  String or = fromCString("OR");
-  String not = fromCString("NOT");
-  String inputStr = fromCString("INPUT");
-  String output = fromCString("OUTPUT");
-
-  if (stringEqual(&component->name, &and)) {
-    Node* child = createNode();
-    node->left = child;
-    node->right = child;
-    child->left = createNode();
-    compileComponent(child->left, project, circuit, &component->inputs[0], parent); 
-    child->right = createNode();
-    compileComponent(child->right, project, circuit, &component->inputs[1], parent); 
-  } else if (stringEqual(&component->name, &or)) {
-    node->left = createNode();
-    node->right = createNode();
-    Node* left = createNode();
-    node->left->left = left;
-    node->left->right = left;
-    compileComponent(left, project, circuit, &component->inputs[0], parent); 
-    Node* right = createNode();
-    node->right->left = right;
-    node->right->right = right;
-    compileComponent(right, project, circuit, &component->inputs[1], parent); 
-  } else if (stringEqual(&component->name, &not)) {
-    Node* child =  createNode();
-    node->left = child;
-    node->right = child;
-    compileComponent(child, project, circuit, &component->inputs[0], parent);
-  } else if (stringEqual(&component->name, &inputStr)) {
-    if (circuit == parent->root) {
-      node->type = INPUT;
-      node->output = component->outputs[0];
-    } else {
-      usize numInput = 0;
-      for (usize i = 0; i < circuit->numComponents; i++) {
-        if (stringEqual(&circuit->components[i].name, &inputStr)) {
-          if (circuit->components[i].id == input->component) break;
-          numInput++;
-        }
-      }
-      printf("Hit %zu input", numInput);
-
-      compileComponent(node, project, parent->circuit, &parent->component->inputs[numInput], parent->parent);
-    }
+// Target and achieved ticks per second below the active circuit, a target of
+// 0 is unlimited
+void drawRate(bool running, double rate, double measured) {
+  char text[96];
+  char target[32];
+  if (rate > 0) {
+    sprintf(target, "%.0f ticks/s", rate);
   } else {
-    for (usize i = 0; i < project->numCircuits; i++) {
-      if (stringEqual(&component->name, &project->circuits[i].name)) {
-        usize counter = 0;
-        for (usize j = 0; j < project->circuits[i].numComponents; j++) {
-          if (stringEqual(&project->circuits[i].components[j].name, &output)) {
-            if (counter++ == input->outputIndex) {
-              Parent p;
-              p.component = component;
-              p.circuit = circuit;
-              p.parent = parent;
-              p.root = parent->root;
-              compileComponent(node, project, &project->circuits[i], &project->circuits[i].components[j].inputs[0], &p);
-            }
-          }
-        }
-      }
-    }
-  }
-
-  destroyString(&and);
-  destroyString(&or);
-  destroyString(&not);
-  destroyString(&inputStr);
-  destroyString(&output);
-}
-
-Tree compileProject(Project* project, Circuit* root) {
-  String output = fromCString("OUTPUT");
-
-  usize numRoots = 0;
-  for (usize i = 0; i < root->numComponents; i++) {
-    if (stringEqual(&root->components[i].name, &output)) {
-      numRoots++;
-    }
-  }
-
-  Tree tree;
-  tree.numRoots = numRoots;
-  tree.roots = malloc(sizeof(Node) * numRoots);
-
-  for (usize i = 0; i < root->numComponents; i++) {
-    if (stringEqual(&root->components[i].name, &output)) {
-      Parent parent;
-      memset(&parent, 0, sizeof(Parent));
-      parent.root = root;
-      compileComponent(&tree.roots[--numRoots], project, root, &root->components[i].inputs[0], &parent);
-    }
+    sprintf(target, "unlimited");
   }
-
-  destroyString(&output);
-
-  return tree;
+  sprintf(text, "%s at %s, %.0f ticks/s", running ? "Running" : "Paused", target, measured);
+  DrawTextEx(GetFontDefault(), text, (Vector2){ 16.0, 16.0 + FONT_SIZE }, FONT_SIZE / 2, FONT_SPACING / 2, PURPLE);
 }
 
-void tickTree(Tree tree) {
-  for (usize i = 0; i < tree.numRoots; i++) {
-     resetNodes(&tree.roots[i]);
+// The heatmap of the components of `circuit`, false unless the coverage is of
+// that circuit. Only its own components count, not those inside instances.
+// With a power model components are shaded by energy rather than toggles.
+bool getHeat(Project* project, Coverage* coverage, PowerModel* power, Circuit* circuit, Heat* heat) {
+  if (coverage->root != circuit->id) return false;
+  memset(heat, 0, sizeof(Heat) * circuit->numComponents);
+  f64* energies = power ? getProbeEnergies(project, coverage, power) : NULL;
+  f64* weights = malloc(sizeof(f64) * (circuit->numComponents + 1));
+  memset(weights, 0, sizeof(f64) * (circuit->numComponents + 1));
+  for (usize i = 0; i < coverage->numProbes; i++) {
+    Probe* probe = &coverage->probes[i];
+    if (probe->path != 0 || probe->circuit != circuit->id || probe->component > circuit->numComponents) continue;
+    Heat* entry = &heat[probe->component - 1];
+    entry->bits++;
+    entry->covered += isProbeCovered(coverage, i);
+    if (energies) entry->energy += energies[i];
+    weights[probe->component - 1] += energies ? energies[i] : getProbeToggles(coverage, i);
   }
-
-  for (usize i = 0; i < tree.numRoots; i++) {
-    printf("%d\n", tickNode(&tree.roots[i]));
-  }
-}
-
-usize getComponentSize(Component* component) {
-  usize size = 0;
-  size += sizeof(component->id);
-  size += sizeof(component->pos);
-  size += sizeof(component->name.length);
-  size += component->name.length;
-  size += sizeof(component->numInputs);
-  size += sizeof(Input) * component->numInputs;
-  size += sizeof(component->numOutputs);
-  size += sizeof(bool) * component->numOutputs;
-  return size;
-}
-
-usize getCircuitSize(Circuit* circuit) {
-  usize size = 0;
-  size += sizeof(circuit->id);
-  size += sizeof(circuit->name.length);
-  size += circuit->name.length;
-  size += sizeof(circuit->numComponents);
+  f64 most = 1;
   for (usize i = 0; i < circuit->numComponents; i++) {
-    size += getComponentSize(&circuit->components[i]);
+    if (weights[i] > most) most = weights[i];
   }
-  return size;
-}
-
-#define PUT(thing) memcpy(&buffer[pointer], &thing, sizeof(thing)); pointer += sizeof(thing)
-
-void saveComponent(Component* component, char* buffer) {
-  usize pointer = 0;
-  PUT(component->id);
-  PUT(component->pos);
-  PUT(component->name.length);
-  memcpy(&buffer[pointer], component->name.data, component->name.length);
-  pointer += component->name.length;
-  PUT(component->numInputs);
-  memcpy(&buffer[pointer], component->inputs, sizeof(Input) * component->numInputs);
-  pointer += sizeof(Input) * component->numInputs;
-  PUT(component->numOutputs);
-  memcpy(&buffer[pointer], component->outputs, sizeof(bool) * component->numOutputs);
-  pointer += sizeof(bool) * component->numOutputs;
-}
-
-void saveCircuit(Circuit* circuit, char* buffer) {
-  usize pointer = 0;
-  PUT(circuit->id);
-  PUT(circuit->name.length);
-  memcpy(&buffer[pointer], circuit->name.data, circuit->name.length);
-  pointer += circuit->name.length;
-  PUT(circuit->numComponents);
   for (usize i = 0; i < circuit->numComponents; i++) {
-    saveComponent(&circuit->components[i], &buffer[pointer]);
-    pointer += getComponentSize(&circuit->components[i]);
+    heat[i].level = log1p(weights[i]) / log1p(most);
   }
+  free(energies);
+  free(weights);
+  return true;
 }
 
-void saveProject(Project* project) {
-  usize size = 0;
-  size += 8; // project->numCircuits
-  for (usize i = 0; i < project->numCircuits; i++) {
-    size += getCircuitSize(&project->circuits[i]);
+// Draws the last `window` ticks of a trace along the bottom of the screen,
+// reading only the records that fall inside it
+void drawWaveforms(Trace* trace, u64 window) {
+  u64 written = atomic_load_explicit(&trace->written, memory_order_acquire);
+  if (written == 0) return;
+  u64 end = atomic_load_explicit(&trace->lastTick, memory_order_acquire) + 1;
+  u64 start = end > window ? end - window : 0;
+
+  f32 row = 24.0;
+  f32 top = GetScreenHeight() - row * trace->numSignals - 8.0;
+  f32 left = 120.0;
+  f32 scale = (GetScreenWidth() - left - 16.0) / (f32)window;
+  DrawRectangle(0, top - 8.0, GetScreenWidth(), GetScreenHeight() - top + 8.0, BACKGROUND);
+  for (usize i = 0; i < trace->numSignals; i++) {
+    Vector2 at = { 16.0, top + row * i + 4.0 };
+    DrawTextEx(GetFontDefault(), trace->signals[i].name, at, FONT_SIZE / 3, FONT_SPACING / 3, PURPLE);
   }
-  printf("Size: %d\n", size);
-
-  char* buffer = malloc(size);
-  memcpy(&buffer[0], &project->numCircuits, sizeof(usize));
-  usize pointer = sizeof(usize);
-  for (usize i = 0; i < project->numCircuits; i++) {
-    saveCircuit(&project->circuits[i], &buffer[pointer]);
-    pointer += getCircuitSize(&project->circuits[i]);
-  }
-
-  FILE* file = fopen("test.logic", "wb+");
-  fwrite(buffer, size, 1, file);
-  fclose(file);
-
-  free(buffer);
-}
-
-#define GET(thing) memcpy(&thing, &buffer[pointer], sizeof(thing)); pointer += sizeof(thing)
-
-usize loadComponent(Component* component, char* buffer) {
-  usize pointer = 0;
-  GET(component->id);
-  GET(component->pos);
-  GET(component->name.length);
-  component->name.data = malloc(component->name.length);
-  memcpy(component->name.data, &buffer[pointer], component->name.length);
-  pointer += component->name.length;
-  GET(component->numInputs);
-  component->inputs = malloc(sizeof(Input) * component->numInputs);
-  memcpy(component->inputs, &buffer[pointer], sizeof(Input) * component->numInputs);
-  pointer += sizeof(Input) * component->numInputs;
-  GET(component->numOutputs);
-  component->outputs = malloc(sizeof(bool) * component->numOutputs);
-  memcpy(component->outputs, &buffer[pointer], sizeof(bool) * component->numOutputs);
-  pointer += sizeof(bool) * component->numOutputs;
-  return pointer;
-}
 
-usize loadCircuit(Circuit* circuit, char* buffer) {
-  usize pointer = 0;
-  GET(circuit->id);
-  GET(circuit->name.length);
-  circuit->name.data = malloc(circuit->name.length);
-  memcpy(circuit->name.data, &buffer[pointer], circuit->name.length);
-  pointer += circuit->name.length;
-  GET(circuit->numComponents);
-  circuit->components = malloc(sizeof(Component) * circuit->numComponents);
-  memset(circuit->components, 0, sizeof(Component) * circuit->numComponents);
-  for (usize i = 0; i < circuit->numComponents; i++) {
-    pointer += loadComponent(&circuit->components[i], &buffer[pointer]);
-  }
-  return pointer;
-}
+  u64* record = malloc(sizeof(u64) * trace->recordWords);
+  u64 until = end;
+  u64 oldest = written > trace->capacity - 1 ? written - (trace->capacity - 1) : 0;
+  for (u64 index = written; index-- > oldest && until > start;) {
+    if (!readRecord(trace, index, record)) break;
+    u64 from = record[0] > start ? record[0] : start;
+    if (from >= until) continue;
+    f32 x0 = left + (from - start) * scale;
+    f32 x1 = left + (until - start) * scale;
+
+    for (usize i = 0; i < trace->numSignals; i++) {
+      Signal* signal = &trace->signals[i];
+      f32 y = top + row * i;
+      bool unknown = false;
+      bool floating = true;
+      u64 value = 0;
+      for (usize bit = 0; bit < signal->width; bit++) {
+        Logic logic = getTracedBit(record + 1, signal->first + bit);
+        if (logic == LOGIC_X) unknown = true;
+        if (logic != LOGIC_Z) floating = false;
+        if (logic == LOGIC_1 && bit < 64) value |= (u64)1 << bit;
+      }
 
-Project loadProject() {
-  FILE* file = fopen("test.logic", "rb");
-  fseek(file, 0, SEEK_END);
-  usize size = ftell(file);
-  fseek(file, 0, SEEK_SET);
-
-  char* buffer = malloc(size);
-  fread(buffer, size, 1, file);
-  usize pointer = 0;
-  
-  Project project;
-  GET(project.numCircuits);
-  printf("numCircuits: %d\n", project.numCircuits);
-  project.circuits = malloc(sizeof(Circuit) * project.numCircuits);
-  memset(project.circuits, 0, sizeof(Circuit) * project.numCircuits);
-  for (usize i = 0; i < project.numCircuits; i++) {
-    pointer += loadCircuit(&project.circuits[i], &buffer[pointer]);
+      Color color = unknown ? YELLOW : floating ? GRAY : value ? GREEN : RED;
+      if (signal->width == 1 && !unknown && !floating) {
+        f32 level = value ? y + 4.0 : y + row - 4.0;
+        DrawLineV((Vector2){ x0, level }, (Vector2){ x1, level }, color);
+        DrawLineV((Vector2){ x0, y + 4.0 }, (Vector2){ x0, y + row - 4.0 }, color);
+      } else if (signal->width == 1) {
+        DrawLineV((Vector2){ x0, y + row / 2 }, (Vector2){ x1, y + row / 2 }, color);
+      } else {
+        DrawRectangleLines(x0, y + 4.0, x1 - x0, row - 8.0, color);
+        if (x1 - x0 > 48.0 && !unknown && !floating) {
+          char text[24];
+          sprintf(text, "%llx", (unsigned long long)value);
+          DrawTextEx(GetFontDefault(), text, (Vector2){ x0 + 4.0, y + 6.0 }, FONT_SIZE / 3, FONT_SPACING / 3, color);
+        }
+      }
+    }
+    until = from;
   }
-  printf("Pointer: %zu\n", pointer);
-  return project;
+  free(record);
 }
 
 int logicol_main() {
@@ -763,77 +667,212 @@ int logicol_main() {
   Camera2D camera = { 0 };
   camera.zoom = 1.0;
 
+  // F simulates four states, G lowers word ops to gates and H calls instances
+  // as modules. Only H compiles incrementally, keeping the modules of the
+  // circuits that did not change. Otherwise every compile flattens it all.
   bool inputting = false;
+  bool fourState = false;
+  bool lowerWords = false;
+  bool hierarchical = false;
   String buffer = createString();
 
+  // The netlist the simulator was last sent, only rebuilt on SPACE, S or L so
+  // editing a large design never waits on a compile. Until then edits and
+  // mode changes leave it stale.
+  Simulator* simulator = createSimulator();
+  ModuleCache modules = { 0 };
+  usize generation = 0;
+  u64 compiledHash = 0;
+  CircuitRef compiled = 0;
+  bool compiledFour = false, compiledHierarchical = false;
+  bool running = false;
+  u64 shown = (u64)-1;
+
+  // Q runs and pauses, W steps once, - and = pick the target rate
+  const double rates[] = { 0, 1, 10, 100, 1000, 10000, 100000, 1000000 };
+  usize rate = 0;
+  double measured = 0;
+  double measuredAt = GetTime();
+  u64 measuredTicks = 0;
+
+  // V starts and stops tracing into trace.vcd, [ and ] zoom the waveforms.
+  // The last trace stays on screen after it stops.
+  Trace* trace = NULL;
+  bool tracing = false;
+  u64 window = 128;
+
+  // E measures toggle coverage of the netlist from the next compile on and
+  // shows it as a heatmap, Y prints the report
+  Coverage* coverage = NULL;
+  bool covering = false, compiledCovering = false;
+  Heat* heat = NULL;
+
+  // Z switches the heatmap to switching energy and J prints the power report.
+  // Capacitances come from capacitance.txt when there is one.
+  PowerModel power = createPowerModel();
+  loadPowerModel(&power, "capacitance.txt");
+  bool showPower = false;
+
 	while (!WindowShouldClose()) {
     Circuit* circuit = getCircuit(&project, active);
 
+    // Outputs only follow snapshots of the current netlist, and only while it
+    // was compiled from the circuit as it is now
+    bool current = getDesignHash(&project, circuit, lowerWords) == compiledHash && active == compiled;
+    bool stale = !current || fourState != compiledFour || hierarchical != compiledHierarchical ||
+                 covering != compiledCovering;
+    Snapshot snapshot = readSnapshot(simulator);
+    if (current && snapshot.generation == generation && generation != 0 && snapshot.ticks != shown) {
+      shown = snapshot.ticks;
+      usize root = 0;
+      for (usize i = 0; i < circuit->numComponents; i++) {
+        Component* component = &circuit->components[i];
+        if (component->kind != KIND_OUTPUT) continue;
+
+        u64 word = 0;
+        component->state = LOGIC_0;
+        for (usize bit = 0; bit < component->width && root < snapshot.numRoots; bit++) {
+          Logic value = snapshot.roots[root++];
+          if (value == LOGIC_1) word |= (u64)1 << bit;
+          if (value == LOGIC_X || (value == LOGIC_Z && component->state != LOGIC_X)) component->state = value;
+        }
+        if (component->state == LOGIC_0 && word) component->state = LOGIC_1;
+        if (!running) printf("%llx\n", (unsigned long long)word);
+
+        Input* input = &component->inputs[0];
+        if (input->component != 0) {
+          getComponent(circuit, input->component)->outputs[input->outputIndex] = word;
+        }
+      }
+      usize numConflicts = snapshot.numConflicts < MAX_CONFLICTS ? snapshot.numConflicts : MAX_CONFLICTS;
+      applyConflicts(&project, snapshot.conflicts, numConflicts, !running);
+    }
+
+    if (GetTime() - measuredAt >= 0.5) {
+      measured = (snapshot.ticks - measuredTicks) / (GetTime() - measuredAt);
+      measuredTicks = snapshot.ticks;
+      measuredAt = GetTime();
+    }
+
     BeginDrawing();
     {
       ClearBackground(BACKGROUND);
-      drawActive(circuit);
+      refreshTiming(&project, circuit);
+      drawActive(circuit, fourState, lowerWords, hierarchical, stale);
+      drawRate(running, rates[rate], measured);
     }
 
 		BeginMode2D(camera);
 		{
-			drawCircuit(circuit);
+      heat = realloc(heat, sizeof(Heat) * (circuit->numComponents + 1));
+      bool heated = coverage && getHeat(&project, coverage, showPower ? &power : NULL, circuit, heat);
+			drawCircuit(&project, circuit, heated ? heat : NULL, showPower);
+
+      ComponentRef added = 0;
 
 			if (!inputting && IsKeyPressed(KEY_A)) {
-				addComponent(circuit, fromCString("AND"), 2, 1);
+				added = placeComponent(&project, circuit, fromCString("AND"), 2, 1);
 			}
 
 			if (!inputting && IsKeyPressed(KEY_O)) {
-				addComponent(circuit, fromCString("OR"), 2, 1);
+				added = placeComponent(&project, circuit, fromCString("OR"), 2, 1);
 			}
 
 			if (!inputting && IsKeyPressed(KEY_X)) {
-				addComponent(circuit, fromCString("XOR"), 2, 1);
+				added = placeComponent(&project, circuit, fromCString("XOR"), 2, 1);
 			}
 
 			if (!inputting && IsKeyPressed(KEY_N)) {
-				addComponent(circuit, fromCString("NOT"), 1, 1);
+				added = placeComponent(&project, circuit, fromCString("NOT"), 1, 1);
+			}
+
+			if (!inputting && IsKeyPressed(KEY_T)) {
+				added = placeComponent(&project, circuit, fromCString("TRISTATE"), 2, 1);
+			}
+
+			if (!inputting && IsKeyPressed(KEY_B)) {
+				added = placeComponent(&project, circuit, fromCString("BUS"), 2, 1);
+			}
+
+			if (!inputting && IsKeyPressed(KEY_P)) {
+				added = placeComponent(&project, circuit, fromCString("SPLIT"), 1, 1);
+			}
+
+			if (!inputting && IsKeyPressed(KEY_M)) {
+				added = placeComponent(&project, circuit, fromCString("MERGE"), 1, 1);
+			}
+
+      // Word ops on the digit keys, starting out 8 bits wide
+      const char* wordOps[] = { "ADD", "SUB", "CMP", "MUX", "SHL", "SHR", "MUL" };
+      for (usize i = 0; i < 7; i++) {
+        if (inputting || !IsKeyPressed(KEY_ONE + i)) continue;
+        usize numInputs = i == 3 ? 3 : 2;
+        usize numOutputs = i < 3 ? 2 : 1;
+        added = placeComponent(&project, circuit, fromCString(wordOps[i]), numInputs, numOutputs);
+        if (isWordOp(getComponent(circuit, added))) setWidth(&project, circuit, getComponent(circuit, added), 8);
+      }
+
+      // Memories start out as 256 bytes, SHIFT + UP and DOWN change the address width
+      if (!inputting && (IsKeyPressed(KEY_R) || IsKeyPressed(KEY_D))) {
+        bool dual = IsKeyPressed(KEY_D);
+        added = placeComponent(&project, circuit, fromCString(dual ? "RAM2" : "RAM"), dual ? 6 : 3, dual ? 2 : 1);
+        if (isMemory(getComponent(circuit, added))) {
+          getComponent(circuit, added)->addressWidth = 8;
+          setWidth(&project, circuit, getComponent(circuit, added), 8);
+        }
+      }
+
+			if (!inputting && IsKeyPressed(KEY_K)) {
+				added = placeComponent(&project, circuit, fromCString("CLOCK"), 0, 1);
 			}
 
 			if (!inputting && IsKeyPressed(KEY_I)) {
-				addComponent(circuit, fromCString("INPUT"), 0, 1);
+				added = addComponent(&project, circuit, fromCString("INPUT"), 0, 1);
         updateInputs(&project, circuit);
 			}
 
 			if (!inputting && IsKeyPressed(KEY_U)) {
-				addComponent(circuit, fromCString("OUTPUT"), 1, 0);
+				added = addComponent(&project, circuit, fromCString("OUTPUT"), 1, 0);
         updateOutputs(&project, circuit);
 			}
 
-      if (inputting && IsKeyPressed(KEY_ENTER)) {
+      // A name ending in .rom or .bin places a ROM mapping that image
+      bool image = buffer.length > 4 && (memcmp(&buffer.data[buffer.length - 4], ".rom", 4) == 0 ||
+                                         memcmp(&buffer.data[buffer.length - 4], ".bin", 4) == 0);
+      if (inputting && image && IsKeyPressed(KEY_ENTER)) {
         inputting = false;
-        CircuitRef found = 0;
-        for (usize i = 0; i < project.numCircuits; i++) {
-          if (stringEqual(&buffer, &project.circuits[i].name)) {
-            found = project.circuits[i].id;
-            break;
-          }
-        }
-
-        if (!found) {
-          found = addCircuit(&project, cloneString(&buffer));
-          circuit = getCircuit(&project, active);
+        added = placeComponent(&project, circuit, fromCString("ROM"), 1, 1);
+        Component* rom = getComponent(circuit, added);
+        if (rom->kind == KIND_ROM) {
+          rom->image = buffer;
+          rom->width = 8;
+          mapImage(rom);
+          rehashComponent(&project, circuit, rom);
+        } else {
+          destroyString(&buffer);
         }
+        buffer = createString();
+      }
 
-        Circuit* child = getCircuit(&project, found);
-        usize numInputs = 0;
-        usize numOutputs = 0;
-        String inputStr = fromCString("INPUT"); 
-        String outputStr = fromCString("OUTPUT"); 
-        for (usize j = 0; j < child->numComponents; j++) {
-          if (stringEqual(&child->components[j].name, &inputStr)) numInputs++;
-          if (stringEqual(&child->components[j].name, &outputStr)) numOutputs++;
+      if (inputting && IsKeyPressed(KEY_ENTER)) {
+        inputting = false;
+        Kind kind = getKind(&buffer);
+        Circuit* existing = findCircuit(&project, &buffer);
+
+        // Names of built-in kinds are only instances in projects that had
+        // such a circuit before the kind was added
+        if (kind == KIND_INPUT || kind == KIND_OUTPUT || (kind != KIND_CIRCUIT && !existing)) {
+          char* name = toCString(&buffer);
+          printf("%s is a built-in component, a circuit cannot be named that\n", name);
+          free(name);
+          destroyString(&buffer);
+        } else {
+          if (!existing) {
+            addCircuit(&project, cloneString(&buffer));
+            circuit = getCircuit(&project, active);
+          }
+          added = placeComponent(&project, circuit, buffer, 0, 0);
         }
-
-        addComponent(circuit, buffer, numInputs, numOutputs);
-
-        destroyString(&inputStr);
-        destroyString(&outputStr);
         buffer = createString();
       }
 
@@ -854,9 +893,20 @@ int logicol_main() {
         inputting = true;
       }
 
+      if (added) updateTiming(&project, circuit, added);
+
 			moveComponent(circuit, camera);
-			createConnection(circuit, camera);
-			toggleInput(circuit, camera);
+			createConnection(&project, circuit, camera);
+			ComponentRef toggled = toggleInput(circuit, camera);
+      if (toggled && current) {
+        Component* input = getComponent(circuit, toggled);
+        Event event = { .type = EVENT_INPUT };
+        event.port = getPortOffset(circuit, toggled);
+        event.width = input->width;
+        event.value = input->outputs[0];
+        sendEvent(simulator, event);
+      }
+      changeWidth(&project, circuit, camera);
       moveCamera(&camera);
 
       if (IsKeyPressed(KEY_S)) {
@@ -864,32 +914,130 @@ int logicol_main() {
       }
 
       if (IsKeyPressed(KEY_L)) {
-        project = loadProject();
-        active = project.circuits[0].id;
+        Project loaded = loadProject("test.logic");
+        if (loaded.numCircuits) {
+          project = loaded;
+          active = project.circuits[0].id;
+        }
       }
       
-      if (IsKeyPressed(KEY_SPACE)) {
-        Tree tree = compileProject(&project, circuit);
-        tickTree(tree);
-        
-        usize counter = tree.numRoots;;
-        String outputStr = fromCString("OUTPUT");
-        for (usize i = 0; i < circuit->numComponents; i++) {
-          if (stringEqual(&circuit->components[i].name, &outputStr)) {
-            Input* input = &circuit->components[i].inputs[0];
-            getComponent(circuit, input->component)->outputs[input->outputIndex] = tree.roots[--counter].output;
+      if (!inputting && IsKeyPressed(KEY_F)) {
+        fourState = !fourState;
+      }
+
+      if (!inputting && IsKeyPressed(KEY_G)) {
+        lowerWords = !lowerWords;
+      }
+
+      if (!inputting && IsKeyPressed(KEY_H)) {
+        hierarchical = !hierarchical;
+      }
+
+      if (!inputting && IsKeyPressed(KEY_Q)) {
+        running = !running;
+        sendEvent(simulator, (Event){ .type = EVENT_RUN, .running = running, .rate = rates[rate] });
+      }
+
+      if (!inputting && (IsKeyPressed(KEY_MINUS) || IsKeyPressed(KEY_EQUAL))) {
+        usize numRates = sizeof(rates) / sizeof(rates[0]);
+        rate = (rate + (IsKeyPressed(KEY_EQUAL) ? 1 : numRates - 1)) % numRates;
+        sendEvent(simulator, (Event){ .type = EVENT_RUN, .running = running, .rate = rates[rate] });
+      }
+
+      if (!inputting && !running && IsKeyPressed(KEY_W)) {
+        sendEvent(simulator, (Event){ .type = EVENT_STEP });
+      }
+
+      if (tracing && atomic_load(&trace->detached)) tracing = false;
+      if (!inputting && IsKeyPressed(KEY_V)) {
+        if (tracing) {
+          sendEvent(simulator, (Event){ .type = EVENT_TRACE, .trace = NULL });
+          tracing = false;
+        } else {
+          if (trace) {
+            while (!atomic_load(&trace->detached)) sleepSeconds(0.001);
+            destroyTrace(trace);
           }
+          trace = createTrace(getCircuit(&project, active), "trace.vcd");
+          tracing = trace != NULL;
+          if (trace) sendEvent(simulator, (Event){ .type = EVENT_TRACE, .trace = trace });
         }
-        destroyString(&outputStr);
+      }
+      if (!inputting && IsKeyPressed(KEY_E)) {
+        covering = !covering;
+      }
+
+      if (!inputting && IsKeyPressed(KEY_Y) && coverage) {
+        reportCoverage(stdout, &project, coverage);
+      }
+
+      if (!inputting && IsKeyPressed(KEY_SLASH)) {
+        printInstances(&project, circuit);
+      }
+
+      if (!inputting && IsKeyPressed(KEY_Z)) {
+        showPower = !showPower;
+      }
+
+      if (!inputting && IsKeyPressed(KEY_J) && coverage) {
+        reportPower(stdout, &project, coverage, &power);
+      }
+
+      if (!inputting && IsKeyPressed(KEY_LEFT_BRACKET) && window > 8) window /= 2;
+      if (!inputting && IsKeyPressed(KEY_RIGHT_BRACKET) && window < 65536) window *= 2;
+
+      if (IsKeyPressed(KEY_SPACE) || IsKeyPressed(KEY_S) || IsKeyPressed(KEY_L)) {
+        circuit = getCircuit(&project, active);
+        u64 design = getDesignHash(&project, circuit, lowerWords);
+        Netlist* netlist = compileSimulation(&project, circuit, lowerWords, hierarchical ? &modules : NULL);
+
+        // Saving the design also caches its netlist, for the next time it is opened
+        if (!hierarchical && (IsKeyPressed(KEY_SPACE) || IsKeyPressed(KEY_S))) {
+          saveNetlist(netlist, design);
+        }
+
+        Event event = { .type = EVENT_NETLIST };
+        event.netlist = netlist;
+        event.fourState = fourState;
+        event.generation = ++generation;
+        event.numRetired = modules.numRetired;
+        event.retired = modules.retired;
+        modules.numRetired = 0;
+        modules.retired = NULL;
+        Coverage* previous = coverage;
+        coverage = covering ? createCoverage(netlist) : NULL;
+        event.coverage = coverage;
+        sendEvent(simulator, event);
+        if (previous) {
+          while (!atomic_load(&previous->detached)) sleepSeconds(0.001);
+          destroyCoverage(previous);
+        }
+
+        compiledHash = design;
+        compiled = active;
+        compiledFour = fourState;
+        compiledHierarchical = hierarchical;
+        compiledCovering = covering;
+        shown = (u64)-1;
+      }
+
+      if (IsKeyPressed(KEY_SPACE)) {
         saveProject(&project);
       }
 
-      active = getActive(&project, circuit);
+      CircuitRef next = getActive(&project, circuit);
+      if (next != active) getCircuit(&project, next)->timingValid = false;
+      active = next;
 		}
     EndMode2D();
+    if (trace) drawWaveforms(trace, window);
 		EndDrawing();
 	}
 
+  destroySimulator(simulator);
+  if (trace) destroyTrace(trace);
+  if (coverage) destroyCoverage(coverage);
+  free(heat);
+  destroyModuleCache(&modules);
 	return 0;
 }
-